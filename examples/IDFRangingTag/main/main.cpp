@@ -0,0 +1,56 @@
+/*
+ * ESP-IDF tag that runs DW1000Ranging::loop() on its own task and wakes that task up as soon as
+ * the chip raises an interrupt, instead of polling it.
+ *
+ * All chip access, interrupt handling included, happens in loop(), so a received POLL or POLL_ACK
+ * is only answered (delayed TX, DEFAULT_REPLY_DELAY_TIME = 3 ms after the reception) once loop()
+ * runs. Polling it with vTaskDelay(1) waits up to one FreeRTOS tick (10 ms at the default 100 Hz)
+ * and the reply misses its slot. The interrupt pending handler is called from the interrupt task
+ * of the port and notifies the loop task, so the reply latency is the wake-up time of that task.
+ * The 1 ms timeout keeps the timer wheel (1 ms resolution) ticking when no interrupt comes; with
+ * the default 100 Hz tick it is 10 ms, hence CONFIG_FREERTOS_HZ=1000 in sdkconfig.defaults.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "idfport.h"
+#include "DW1000Ranging.h"
+
+static IDFPort port;
+static DW1000Ranging ranging(port);
+static TaskHandle_t loopTask;
+
+// interrupt task of the port, no chip access here
+static void interruptPending()
+{
+	xTaskNotifyGive(loopTask);
+}
+
+static void newRange(DW1000Device *device)
+{
+	port.log_inf("TAG", "range from %04X: %.2f m", device->getShortAddress(), device->getRange());
+}
+
+// owns the chip: init() and loop() both run here
+static void rangingLoop(void *)
+{
+	loopTask = xTaskGetCurrentTaskHandle();
+	ranging.attachInterruptPending(interruptPending);
+	ranging.init(BoardType::TAG, 0x7D00, "22:EA:82:60:3B:9C", false, PROFILE_LONGDATA_RANGE_LOWPOWER);
+	// init() resets the protocol handlers
+	ranging.attachNewRange(newRange);
+	// at least one tick when the tick period is longer than 1 ms
+	const TickType_t idleWait = pdMS_TO_TICKS(1) > 0 ? pdMS_TO_TICKS(1) : 1;
+	while (true)
+	{
+		ranging.loop();
+		ulTaskNotifyTake(pdTRUE, idleWait);
+	}
+}
+
+extern "C" void app_main(void)
+{
+	port.begin();
+	// above the priority of the application tasks, below the interrupt task of the port (5)
+	xTaskCreatePinnedToCore(rangingLoop, "RangingLoop", 4096, nullptr, 4, nullptr, 1);
+}
@@ -11,20 +11,18 @@
 
 #define PIN_LED GPIO_NUM_1
 
-#define PIN_RST GPIO_NUM_39
-#define PIN_IRQ GPIO_NUM_40
-#define PIN_SS GPIO_NUM_10
-
 #define SPI_MOSI 11
 #define SPI_MISO 13
 #define SPI_CLK 12
 
-IDFPort *IDFPort::_self;
-
 void IRAM_ATTR IDFPort::_gpio_isr_helper(void *arg)
 {
-    if (_self->_sem)
-        xSemaphoreGiveFromISR(_self->_sem, NULL);
+    IDFPort *port = (IDFPort *)arg;
+    BaseType_t woken = pdFALSE;
+    if (port->_sem)
+        xSemaphoreGiveFromISR(port->_sem, &woken);
+    // switch to the interrupt task right away instead of at the next tick
+    portYIELD_FROM_ISR(woken);
 }
 
 void IDFPort::delay_ms(uint32_t ms)
@@ -41,6 +39,11 @@ uint32_t IDFPort::millis(void)
     return (uint32_t)(esp_timer_get_time() / 1000);
 }
 
+uint32_t IDFPort::micros(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
 int IDFPort::random(int min, int max)
 {
     return (esp_random() % (max - min)) + min;
@@ -48,16 +51,39 @@ int IDFPort::random(int min, int max)
 
 void IDFPort::dw1000_reset(void)
 {
-    gpio_set_direction(PIN_RST, GPIO_MODE_OUTPUT);
-    gpio_set_level(PIN_RST, 0);
+    dw1000_set_reset(true);
     delay_ms(2);
-    gpio_set_direction(PIN_RST, GPIO_MODE_INPUT); // DW1000 Reset should not be pulled HIGH. it should be kept floating
+    dw1000_set_reset(false);
     delay_ms(10);
 }
 
+void IDFPort::dw1000_set_reset(bool asserted)
+{
+    if (asserted)
+    {
+        gpio_set_direction(_pinRST, GPIO_MODE_OUTPUT);
+        gpio_set_level(_pinRST, 0);
+    }
+    else
+    {
+        gpio_set_direction(_pinRST, GPIO_MODE_INPUT); // DW1000 Reset should not be pulled HIGH. it should be kept floating
+    }
+}
+
 void IDFPort::dw1000_select(bool _select)
 {
-    gpio_set_level(PIN_SS, _select ? 0 : 1);
+    // the other radios on the bus wait while this one is selected, CS is driven by software
+    if (_select && !_selected)
+    {
+        spi_device_acquire_bus(_spi_handle, portMAX_DELAY);
+        _selected = true;
+    }
+    gpio_set_level(_pinSS, _select ? 0 : 1);
+    if (!_select && _selected)
+    {
+        _selected = false;
+        spi_device_release_bus(_spi_handle);
+    }
 }
 
 void IDFPort::dw1000_spi_read(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen)
@@ -116,44 +142,55 @@ void IDFPort::spi_transfer(uint8_t *header, size_t hLen, uint8_t *data, size_t d
 
 void IDFPort::begin()
 {
-    // CS, RST and IRQ gpios to be initialized
+    // CS, RST and IRQ gpios of this radio to be initialized
     gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << PIN_SS),
+        .pin_bit_mask = (1ULL << _pinSS),
         .mode = GPIO_MODE_OUTPUT,
         .pull_up_en = GPIO_PULLUP_DISABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
         .intr_type = GPIO_INTR_DISABLE};
     // Apply settings
     gpio_config(&io_conf);
-    gpio_set_level(PIN_SS, 1);
+    gpio_set_level(_pinSS, 1);
 
-    io_conf.pin_bit_mask = (1ULL << PIN_LED);
-    gpio_config(&io_conf);
-    gpio_set_level(PIN_LED, 1);
+    if (!_busInitialized)
+    {
+        io_conf.pin_bit_mask = (1ULL << PIN_LED);
+        gpio_config(&io_conf);
+        gpio_set_level(PIN_LED, 1);
+    }
 
-    io_conf.pin_bit_mask = (1ULL << PIN_RST);
+    io_conf.pin_bit_mask = (1ULL << _pinRST);
     io_conf.mode = GPIO_MODE_INPUT;
     gpio_config(&io_conf);
 
-    io_conf.pin_bit_mask = (1ULL << PIN_IRQ);
+    io_conf.pin_bit_mask = (1ULL << _pinIRQ);
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.intr_type = GPIO_INTR_POSEDGE;
     gpio_config(&io_conf);
 
-    gpio_install_isr_service(0);
-
-    gpio_isr_handler_add(PIN_IRQ, IDFPort::_gpio_isr_helper, (void *)this);
+    if (!_isrServiceInstalled)
+    {
+        gpio_install_isr_service(0);
+        _isrServiceInstalled = true;
+    }
 
-    spi_bus_config_t buscfg;
-    memset(&buscfg, 0, sizeof(spi_bus_config_t));
-    buscfg.miso_io_num = SPI_MISO;
-    buscfg.mosi_io_num = SPI_MOSI;
-    buscfg.sclk_io_num = SPI_CLK;
-    buscfg.quadwp_io_num = -1;
-    buscfg.quadhd_io_num = -1;
-    buscfg.max_transfer_sz = 4096;
+    gpio_isr_handler_add(_pinIRQ, IDFPort::_gpio_isr_helper, (void *)this);
 
-    spi_bus_initialize(SPI2_HOST, &buscfg, SPI_DMA_CH_AUTO);
+    if (!_busInitialized)
+    {
+        spi_bus_config_t buscfg;
+        memset(&buscfg, 0, sizeof(spi_bus_config_t));
+        buscfg.miso_io_num = SPI_MISO;
+        buscfg.mosi_io_num = SPI_MOSI;
+        buscfg.sclk_io_num = SPI_CLK;
+        buscfg.quadwp_io_num = -1;
+        buscfg.quadhd_io_num = -1;
+        buscfg.max_transfer_sz = 4096;
+
+        spi_bus_initialize(SPI2_HOST, &buscfg, SPI_DMA_CH_AUTO);
+        _busInitialized = true;
+    }
 
     spi_device_interface_config_t devcfg;
     memset(&devcfg, 0, sizeof(spi_device_interface_config_t));
@@ -234,18 +271,19 @@ void IDFPort::log_vrb(const std::string &_tag, const char *msg, ...)
 void IDFPort::dw1000_irq_isr(std::function<void()> callable)
 {
     interrupt_handler = callable;
-    xTaskCreatePinnedToCore(IDFPort::_InvokeInterrupt, "InterruptTASK", 2048, NULL, 5, NULL, 0);
-    // TODO: set up a RTOS TASK which will call callable() when interrupt semaphore is given
+    // one task per radio, so a busy radio does not delay the interrupts of the others
+    xTaskCreatePinnedToCore(IDFPort::_InvokeInterrupt, "InterruptTASK", 2048, this, 5, NULL, 0);
 }
 
 void IDFPort::_InvokeInterrupt(void *param)
 {
+    IDFPort *port = (IDFPort *)param;
     while (true)
     {
-        if (xSemaphoreTake(_self->_sem, portMAX_DELAY) == pdTRUE)
+        if (xSemaphoreTake(port->_sem, portMAX_DELAY) == pdTRUE)
         {
-            if (_self->interrupt_handler != NULL)
-                _self->interrupt_handler();
+            if (port->interrupt_handler != NULL)
+                port->interrupt_handler();
         }
     }
 }
\ No newline at end of file
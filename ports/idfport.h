@@ -8,7 +8,17 @@
 #include <functional>
 
 #include "driver/spi_master.h"
+#include "driver/gpio.h"
 
+// lines of the first radio, further radios on the same SPI bus pass their own
+#define IDF_DEFAULT_PIN_RST GPIO_NUM_39
+#define IDF_DEFAULT_PIN_IRQ GPIO_NUM_40
+#define IDF_DEFAULT_PIN_SS GPIO_NUM_10
+
+/*
+ * One port per DW1000. All ports share one SPI bus, each has its own chip select, reset and IRQ
+ * line and its own interrupt task, so the interrupts are dispatched to the right driver instance.
+ */
 class IDFPort : public PortableCode
 {
 public:
@@ -21,18 +31,23 @@ public:
         LOG_LEVEL_ERROR = 4,
     } LogLevel;
 
-    IDFPort()
+    IDFPort(gpio_num_t pinSS = IDF_DEFAULT_PIN_SS, gpio_num_t pinIRQ = IDF_DEFAULT_PIN_IRQ, gpio_num_t pinRST = IDF_DEFAULT_PIN_RST)
     {
-        _self = this;
+        _pinSS = pinSS;
+        _pinIRQ = pinIRQ;
+        _pinRST = pinRST;
+        _selected = false;
         _sem = xSemaphoreCreateBinary();
         _default_level = LogLevel::LOG_LEVEL_INFO;
         _print_tag = false;
     }
     uint32_t millis();
+    uint32_t micros();
     void delay_ms(uint32_t);
     void delay_us(uint32_t);
     int random(int, int);
     void dw1000_reset(void);
+    void dw1000_set_reset(bool);
     void dw1000_select(bool);
     void dw1000_spi_read(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen);
     void dw1000_spi_write(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen);
@@ -58,7 +73,15 @@ protected:
         {LogLevel::LOG_LEVEL_ERROR, "Error"},
     };
 
-    static IDFPort *_self;
+    // shared by all ports
+    inline static bool _busInitialized = false;
+    inline static bool _isrServiceInstalled = false;
+
+    gpio_num_t _pinSS;
+    gpio_num_t _pinIRQ;
+    gpio_num_t _pinRST;
+    // the bus is held from chip select to deselect
+    bool _selected;
     bool _print_tag;
     LogLevel _default_level;
     std::unordered_map<std::string, LogLevel> logLevels;
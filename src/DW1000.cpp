@@ -2,8 +2,9 @@
 
 DW1000::DW1000(PortableCode &portable) : _portable(portable)
 {
-	_vmeas3v3 = 0;
-	_tmeas23C = 0;
+	memset(&_calibration, 0, sizeof(_calibration));
+	_crystalTrim = 0x10;
+	_crystalTrimmed = false;
 	_extendedFrameLength = FRAME_LENGTH_NORMAL;
 	_pacSize = PAC_SIZE_8;
 	_pulseFrequency = TX_PULSE_FREQ_16MHZ;
@@ -15,8 +16,24 @@ DW1000::DW1000(PortableCode &portable) : _portable(portable)
 	_smartPower = false;
 	_frameCheck = true;
 	_permanentReceive = false;
+	_receiveWindowBounded = false;
 	_deviceMode = IDLE_MODE; // TODO replace by enum
 	_debounceClockEnabled = false;
+	_sniffMode = false;
+	_deferredInterrupts = false;
+	_interruptPending = false;
+	_bringUpStep = BringUpStep::NONE;
+	_bringUpDue = 0;
+	_bringUpStepStart = 0;
+	memset(_bringUpTimes, 0, sizeof(_bringUpTimes));
+	_bringUpOk = false;
+	_handleReady = nullptr;
+	_restoredRegisters = 0;
+	_doubleBuffered = false;
+	_rxQueueHead = 0;
+	_rxQueueTail = 0;
+	_rxFrameValid = false;
+	_receiveOverruns = 0;
 
 	_handleError = nullptr;
 	_handleSent = nullptr;
@@ -32,60 +49,166 @@ void DW1000::end()
 
 void DW1000::select()
 {
-	_portable.dw1000_select(false); // we re-do selection with pulling CS-high
-	// try locking clock at PLL speed (should be done already,
-	// but just to be sure)
-	enableClock(AUTO_CLOCK);
-	_portable.delay_ms(5);
-	// reset chip (either soft or hard)
-	reset();
-	// default network and node id
-	writeValueToBytes(_networkAndAddress, 0xFF, LEN_PANADR);
-	writeNetworkIdAndDeviceAddress();
-	// default system configuration
-	memset(_syscfg, 0, LEN_SYS_CFG);
-	setDoubleBuffering(false);
-	setInterruptPolarity(true);
-	writeSystemConfigurationRegister();
-	// default interrupt mask, i.e. no interrupts
-	clearInterrupts();
-	writeSystemEventMaskRegister();
-	// load LDE micro-code
-	enableClock(XTI_CLOCK);
-	_portable.delay_ms(5);
-	manageLDE();
-	_portable.delay_ms(5);
-	enableClock(AUTO_CLOCK);
-	_portable.delay_ms(5);
-
-	// read the temp and vbat readings from OTP that were recorded during production test
-	// see 6.3.1 OTP memory map
-	uint8_t buf_otp[4] = {};
-	readBytesOTP(0x008, buf_otp); // the stored 3.3 V reading
-	_vmeas3v3 = buf_otp[0];
-	readBytesOTP(0x009, buf_otp); // the stored 23C reading
-	_tmeas23C = buf_otp[0];
+	for (uint8_t step = (uint8_t)BringUpStep::CLOCK; step < (uint8_t)BringUpStep::DONE; step++)
+	{
+		_portable.delay_ms(runBringUpStep((BringUpStep)step));
+	}
+	_bringUpStep = _bringUpOk ? BringUpStep::DONE : BringUpStep::FAILED;
 }
 
 void DW1000::begin()
 {
 	// generous initial init/wake-up-idle delay
-	_portable.delay_ms(5);
-
-	_deviceMode = IDLE_MODE;
+	_portable.delay_ms(runBringUpStep(BringUpStep::SETTLE));
 
 	select();
 
 	_portable.dw1000_irq_isr([&]()
-							 { handleInterrupt(); });
+							 { onInterrupt(); });
 }
 
-void DW1000::manageLDE()
+void DW1000::beginAsync(std::function<void(bool)> handleReady)
+{
+	_handleReady = handleReady;
+	memset(_bringUpTimes, 0, sizeof(_bringUpTimes));
+	_bringUpStep = BringUpStep::SETTLE;
+	_bringUpDue = _portable.millis();
+	_bringUpStepStart = _bringUpDue;
+}
+
+bool DW1000::serviceBringUp()
+{
+	if (_bringUpStep == BringUpStep::NONE || _bringUpStep >= BringUpStep::DONE)
+	{
+		return false;
+	}
+	uint32_t now = _portable.millis();
+	if ((int32_t)(now - _bringUpDue) < 0)
+	{
+		return true;
+	}
+	// the previous step is over once its wait has elapsed
+	if (_bringUpStep != BringUpStep::SETTLE)
+	{
+		_bringUpTimes[(uint8_t)_bringUpStep - 1] = now - _bringUpStepStart;
+	}
+	uint32_t wait = runBringUpStep(_bringUpStep);
+	_bringUpStepStart = now;
+	_bringUpDue = now + wait;
+	_bringUpStep = (BringUpStep)((uint8_t)_bringUpStep + 1);
+	if (_bringUpStep != BringUpStep::DONE)
+	{
+		return true;
+	}
+	_bringUpTimes[(uint8_t)BringUpStep::OTP] = _portable.millis() - now;
+	if (!_bringUpOk)
+	{
+		_bringUpStep = BringUpStep::FAILED;
+	}
+	_portable.dw1000_irq_isr([&]()
+							 { onInterrupt(); });
+	if (_handleReady != nullptr)
+	{
+		_handleReady(_bringUpOk);
+	}
+	return false;
+}
+
+uint32_t DW1000::runBringUpStep(BringUpStep step)
+{
+	switch (step)
+	{
+	case BringUpStep::SETTLE:
+		_deviceMode = IDLE_MODE;
+		return 5;
+	case BringUpStep::CLOCK:
+		_portable.dw1000_select(false); // we re-do selection with pulling CS-high
+		// try locking clock at PLL speed (should be done already,
+		// but just to be sure)
+		enableClock(AUTO_CLOCK);
+		return 5;
+	case BringUpStep::RESET:
+		// hard reset, the line must not be driven high but released
+		_portable.dw1000_set_reset(true);
+		return 2;
+	case BringUpStep::RESET_RELEASE:
+		_portable.dw1000_set_reset(false);
+		return 10;
+	case BringUpStep::CONFIGURE:
+		idle(); // force into idle mode (although it should be already after reset)
+		_sniffMode = false;
+		// default network and node id
+		writeValueToBytes(_networkAndAddress, 0xFF, LEN_PANADR);
+		writeNetworkIdAndDeviceAddress();
+		// default system configuration
+		memset(_syscfg, 0, LEN_SYS_CFG);
+		setDoubleBuffering(false);
+		setInterruptPolarity(true);
+		writeSystemConfigurationRegister();
+		// default interrupt mask, i.e. no interrupts
+		clearInterrupts();
+		writeSystemEventMaskRegister();
+		// load LDE micro-code
+		enableClock(XTI_CLOCK);
+		return 5;
+	case BringUpStep::LDE_LOAD:
+		// the OTP does not change, a reselect needs no reading
+		if (!_calibration.loaded)
+		{
+			loadCalibration();
+		}
+		startLDELoad();
+		return 5;
+	case BringUpStep::LDE_DONE:
+		finishLDELoad();
+		return 5;
+	case BringUpStep::CLOCK_AUTO:
+		enableClock(AUTO_CLOCK);
+		return 5;
+	case BringUpStep::OTP:
+	{
+		uint8_t devId[LEN_DEV_ID] = {};
+		readBytes(DEV_ID, NO_SUB, devId, LEN_DEV_ID);
+		_bringUpOk = devId[3] == 0xDE && devId[2] == 0xCA;
+		if (!_bringUpOk)
+		{
+			// the calibration was read from a chip not answering, read it again next time
+			_calibration.loaded = false;
+		}
+		return 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+void DW1000::loadCalibration()
+{
+	// the words recorded during production test, see 6.3.1 OTP memory map
+	static const uint16_t addresses[] = {OTP_EUI_ADDR, OTP_EUI_ADDR + 1, OTP_LDOTUNE_ADDR, OTP_VMEAS_ADDR,
+										 OTP_TMEAS_ADDR, OTP_ANTD_ADDR, OTP_XTALT_ADDR};
+	constexpr uint8_t n = sizeof(addresses) / sizeof(addresses[0]);
+	uint8_t words[n][LEN_OTP_RDAT] = {};
+	readBytesOTP(addresses, words, n);
+
+	// the EUI is stored little endian, low word first
+	for (uint8_t i = 0; i < LEN_EUI; i++)
+	{
+		_calibration.eui[LEN_EUI - 1 - i] = words[i / LEN_OTP_RDAT][i % LEN_OTP_RDAT];
+	}
+	memcpy(_calibration.ldoTune, words[2], LEN_OTP_RDAT);
+	_calibration.vmeas3v3 = words[3][0];
+	_calibration.tmeas23C = words[4][0];
+	_calibration.antennaDelay16MHz = (uint16_t)words[5][1] << 8 | words[5][0];
+	_calibration.antennaDelay64MHz = (uint16_t)words[5][3] << 8 | words[5][2];
+	_calibration.xtalTrim = words[6][0] & 0x1F;
+	_calibration.loaded = true;
+}
+
+void DW1000::startLDELoad()
 {
 	// transfer any ldo tune values
-	uint8_t ldoTune[LEN_OTP_RDAT];
-	readBytesOTP(0x04, ldoTune); // TODO #define
-	if (ldoTune[0] != 0)
+	if (_calibration.ldoTune[0] != 0)
 	{
 		// TODO tuning available, copy over to RAM: use OTP_LDO bit
 	}
@@ -103,7 +226,14 @@ void DW1000::manageLDE()
 	otpctrl[1] = 0x80;
 	writeBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, 2);
 	writeBytes(OTP_IF, OTP_CTRL_SUB, otpctrl, 2);
-	_portable.delay_ms(5);
+}
+
+void DW1000::finishLDELoad()
+{
+	// the upload takes ~150 us after startLDELoad()
+	uint8_t pmscctrl0[LEN_PMSC_CTRL0];
+	memset(pmscctrl0, 0, LEN_PMSC_CTRL0);
+	readBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, LEN_PMSC_CTRL0);
 	pmscctrl0[0] = 0x00;
 	pmscctrl0[1] &= 0x02;
 	writeBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, 2);
@@ -173,11 +303,18 @@ void DW1000::setGPIOMode(uint8_t msgp, uint8_t mode)
 
 void DW1000::deepSleep()
 {
+	// sleep is entered from idle only
+	idle();
+
 	uint8_t aon_wcfg[LEN_AON_WCFG];
 	memset(aon_wcfg, 0, LEN_AON_WCFG);
 	readBytes(AON, AON_WCFG_SUB, aon_wcfg, LEN_AON_WCFG);
 	setBit(aon_wcfg, LEN_AON_WCFG, ONW_LDC_BIT, true);
+	// reload the LDE microcode on wake-up, the timestamps are wrong without it
+	setBit(aon_wcfg, LEN_AON_WCFG, ONW_LLDE_BIT, true);
 	setBit(aon_wcfg, LEN_AON_WCFG, ONW_LDD0_BIT, true);
+	// keep sleep enabled so the next deepSleep() goes through the same path
+	setBit(aon_wcfg, LEN_AON_WCFG, PRES_SLEEP_BIT, true);
 	writeBytes(AON, AON_WCFG_SUB, aon_wcfg, LEN_AON_WCFG);
 
 	uint8_t pmsc_ctrl1[LEN_PMSC_CTRL1];
@@ -202,6 +339,7 @@ void DW1000::deepSleep()
 	setBit(aon_ctrl, LEN_AON_CTRL, UPL_CFG_BIT, true);
 	setBit(aon_ctrl, LEN_AON_CTRL, SAVE_BIT, true);
 	writeBytes(AON, AON_CTRL_SUB, aon_ctrl, LEN_AON_CTRL);
+	_deviceMode = IDLE_MODE;
 }
 
 void DW1000::spiWakeup()
@@ -216,6 +354,31 @@ void DW1000::spiWakeup()
 	}
 }
 
+bool DW1000::restoreFromSleep()
+{
+	// the chip runs from the crystal while it uploads the AON configuration and relocks the PLL
+	_portable.dw1000_set_spi_speed(PortableCode::SLOW_SPI);
+	_portable.delay_ms(3);
+
+	uint8_t devId[LEN_DEV_ID] = {};
+	readBytes(DEV_ID, NO_SUB, devId, LEN_DEV_ID);
+	if (devId[3] != 0xDE || devId[2] != 0xCA)
+	{
+		// still asleep or lost its configuration
+		return false;
+	}
+	enableClock(AUTO_CLOCK);
+
+	// the RX antenna delay lives in LDE RAM and is not part of the AON configuration
+	uint8_t antennaDelayBytes[DW1000Time::LENGTH_TIMESTAMP];
+	_antennaDelay.getTimestamp(antennaDelayBytes);
+	writeBytes(LDE_IF, LDE_RXANTD_SUB, antennaDelayBytes, LEN_LDE_RXANTD);
+	writeSystemEventMaskRegister();
+	clearAllStatus();
+	_deviceMode = IDLE_MODE;
+	return true;
+}
+
 void DW1000::reset(bool _soft)
 {
 	if (_soft)
@@ -252,613 +415,134 @@ void DW1000::enableMode(const uint8_t mode[])
 	setPreambleLength(mode[2]);
 }
 
-void DW1000::tune()
+void DW1000::enableProfile(const RadioProfile &profile)
 {
-	// these registers are going to be tuned/configured
-	uint8_t agctune1[LEN_AGC_TUNE1];
-	uint8_t agctune2[LEN_AGC_TUNE2];
-	uint8_t agctune3[LEN_AGC_TUNE3];
-	uint8_t drxtune0b[LEN_DRX_TUNE0b];
-	uint8_t drxtune1a[LEN_DRX_TUNE1a];
-	uint8_t drxtune1b[LEN_DRX_TUNE1b];
-	uint8_t drxtune2[LEN_DRX_TUNE2];
-	uint8_t drxtune4H[LEN_DRX_TUNE4H];
-	uint8_t ldecfg1[LEN_LDE_CFG1];
-	uint8_t ldecfg2[LEN_LDE_CFG2];
-	uint8_t lderepc[LEN_LDE_REPC];
-	uint8_t txpower[LEN_TX_POWER];
-	uint8_t rfrxctrlh[LEN_RF_RXCTRLH];
-	uint8_t rftxctrl[LEN_RF_TXCTRL];
-	uint8_t tcpgdelay[LEN_TC_PGDELAY];
-	uint8_t fspllcfg[LEN_FS_PLLCFG];
-	uint8_t fsplltune[LEN_FS_PLLTUNE];
-	uint8_t fsxtalt[LEN_FS_XTALT];
-	// AGC_TUNE1
-	if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-	{
-		writeValueToBytes(agctune1, 0x8870, LEN_AGC_TUNE1);
-	}
-	else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-	{
-		writeValueToBytes(agctune1, 0x889B, LEN_AGC_TUNE1);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// AGC_TUNE2
-	writeValueToBytes(agctune2, 0x2502A907L, LEN_AGC_TUNE2);
-	// AGC_TUNE3
-	writeValueToBytes(agctune3, 0x0035, LEN_AGC_TUNE3);
-	// DRX_TUNE0b (already optimized according to Table 20 of user manual)
-	if (_dataRate == TRX_RATE_110KBPS)
-	{
-		writeValueToBytes(drxtune0b, 0x0016, LEN_DRX_TUNE0b);
-	}
-	else if (_dataRate == TRX_RATE_850KBPS)
-	{
-		writeValueToBytes(drxtune0b, 0x0006, LEN_DRX_TUNE0b);
-	}
-	else if (_dataRate == TRX_RATE_6800KBPS)
-	{
-		writeValueToBytes(drxtune0b, 0x0001, LEN_DRX_TUNE0b);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// DRX_TUNE1a
-	if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-	{
-		writeValueToBytes(drxtune1a, 0x0087, LEN_DRX_TUNE1a);
-	}
-	else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-	{
-		writeValueToBytes(drxtune1a, 0x008D, LEN_DRX_TUNE1a);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// DRX_TUNE1b
-	if (_preambleLength == TX_PREAMBLE_LEN_1536 || _preambleLength == TX_PREAMBLE_LEN_2048 ||
-		_preambleLength == TX_PREAMBLE_LEN_4096)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(drxtune1b, 0x0064, LEN_DRX_TUNE1b);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_preambleLength != TX_PREAMBLE_LEN_64)
-	{
-		if (_dataRate == TRX_RATE_850KBPS || _dataRate == TRX_RATE_6800KBPS)
-		{
-			writeValueToBytes(drxtune1b, 0x0020, LEN_DRX_TUNE1b);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else
-	{
-		if (_dataRate == TRX_RATE_6800KBPS)
-		{
-			writeValueToBytes(drxtune1b, 0x0010, LEN_DRX_TUNE1b);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	// DRX_TUNE2
-	if (_pacSize == PAC_SIZE_8)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x311A002DL, LEN_DRX_TUNE2);
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x313B006BL, LEN_DRX_TUNE2);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_pacSize == PAC_SIZE_16)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x331A0052L, LEN_DRX_TUNE2);
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x333B00BEL, LEN_DRX_TUNE2);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_pacSize == PAC_SIZE_32)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x351A009AL, LEN_DRX_TUNE2);
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x353B015EL, LEN_DRX_TUNE2);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_pacSize == PAC_SIZE_64)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x371A011DL, LEN_DRX_TUNE2);
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			writeValueToBytes(drxtune2, 0x373B0296L, LEN_DRX_TUNE2);
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// DRX_TUNE4H
-	if (_preambleLength == TX_PREAMBLE_LEN_64)
-	{
-		writeValueToBytes(drxtune4H, 0x0010, LEN_DRX_TUNE4H);
-	}
-	else
-	{
-		writeValueToBytes(drxtune4H, 0x0028, LEN_DRX_TUNE4H);
-	}
-	// RF_RXCTRLH
-	if (_channel != CHANNEL_4 && _channel != CHANNEL_7)
-	{
-		writeValueToBytes(rfrxctrlh, 0xD8, LEN_RF_RXCTRLH);
-	}
-	else
-	{
-		writeValueToBytes(rfrxctrlh, 0xBC, LEN_RF_RXCTRLH);
-	}
-	// RX_TXCTRL
-	if (_channel == CHANNEL_1)
-	{
-		writeValueToBytes(rftxctrl, 0x00005C40L, LEN_RF_TXCTRL);
-	}
-	else if (_channel == CHANNEL_2)
-	{
-		writeValueToBytes(rftxctrl, 0x00045CA0L, LEN_RF_TXCTRL);
-	}
-	else if (_channel == CHANNEL_3)
-	{
-		writeValueToBytes(rftxctrl, 0x00086CC0L, LEN_RF_TXCTRL);
-	}
-	else if (_channel == CHANNEL_4)
-	{
-		writeValueToBytes(rftxctrl, 0x00045C80L, LEN_RF_TXCTRL);
-	}
-	else if (_channel == CHANNEL_5)
-	{
-		writeValueToBytes(rftxctrl, 0x001E3FE0L, LEN_RF_TXCTRL);
-	}
-	else if (_channel == CHANNEL_7)
-	{
-		writeValueToBytes(rftxctrl, 0x001E7DE0L, LEN_RF_TXCTRL);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// TC_PGDELAY
-	if (_channel == CHANNEL_1)
-	{
-		writeValueToBytes(tcpgdelay, 0xC9, LEN_TC_PGDELAY);
-	}
-	else if (_channel == CHANNEL_2)
-	{
-		writeValueToBytes(tcpgdelay, 0xC2, LEN_TC_PGDELAY);
-	}
-	else if (_channel == CHANNEL_3)
-	{
-		writeValueToBytes(tcpgdelay, 0xC5, LEN_TC_PGDELAY);
-	}
-	else if (_channel == CHANNEL_4)
-	{
-		writeValueToBytes(tcpgdelay, 0x95, LEN_TC_PGDELAY);
-	}
-	else if (_channel == CHANNEL_5)
-	{
-		writeValueToBytes(tcpgdelay, 0xC0, LEN_TC_PGDELAY);
-	}
-	else if (_channel == CHANNEL_7)
-	{
-		writeValueToBytes(tcpgdelay, 0x93, LEN_TC_PGDELAY);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// FS_PLLCFG and FS_PLLTUNE
-	if (_channel == CHANNEL_1)
-	{
-		writeValueToBytes(fspllcfg, 0x09000407L, LEN_FS_PLLCFG);
-		writeValueToBytes(fsplltune, 0x1E, LEN_FS_PLLTUNE);
-	}
-	else if (_channel == CHANNEL_2 || _channel == CHANNEL_4)
-	{
-		writeValueToBytes(fspllcfg, 0x08400508L, LEN_FS_PLLCFG);
-		writeValueToBytes(fsplltune, 0x26, LEN_FS_PLLTUNE);
-	}
-	else if (_channel == CHANNEL_3)
-	{
-		writeValueToBytes(fspllcfg, 0x08401009L, LEN_FS_PLLCFG);
-		writeValueToBytes(fsplltune, 0x56, LEN_FS_PLLTUNE);
-	}
-	else if (_channel == CHANNEL_5 || _channel == CHANNEL_7)
-	{
-		writeValueToBytes(fspllcfg, 0x0800041DL, LEN_FS_PLLCFG);
-		writeValueToBytes(fsplltune, 0xBE, LEN_FS_PLLTUNE);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// LDE_CFG1
-	writeValueToBytes(ldecfg1, 0xD, LEN_LDE_CFG1);
-	// LDE_CFG2
-	if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-	{
-		writeValueToBytes(ldecfg2, 0x1607, LEN_LDE_CFG2);
-	}
-	else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-	{
-		writeValueToBytes(ldecfg2, 0x0607, LEN_LDE_CFG2);
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// LDE_REPC
-	if (_preambleCode == PREAMBLE_CODE_16MHZ_1 || _preambleCode == PREAMBLE_CODE_16MHZ_2)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x5998 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x5998, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_16MHZ_3 || _preambleCode == PREAMBLE_CODE_16MHZ_8)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x51EA >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x51EA, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_16MHZ_4)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x428E >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x428E, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_16MHZ_5)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x451E >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x451E, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_16MHZ_6)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x2E14 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x2E14, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_16MHZ_7)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x8000 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x8000, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_9)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x28F4 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x28F4, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_10 || _preambleCode == PREAMBLE_CODE_64MHZ_17)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x3332 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x3332, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_11)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x3AE0 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x3AE0, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_12)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x3D70 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x3D70, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_18 || _preambleCode == PREAMBLE_CODE_64MHZ_19)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x35C2 >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x35C2, LEN_LDE_REPC);
-		}
-	}
-	else if (_preambleCode == PREAMBLE_CODE_64MHZ_20)
-	{
-		if (_dataRate == TRX_RATE_110KBPS)
-		{
-			writeValueToBytes(lderepc, ((0x47AE >> 3) & 0xFFFF), LEN_LDE_REPC);
-		}
-		else
-		{
-			writeValueToBytes(lderepc, 0x47AE, LEN_LDE_REPC);
-		}
-	}
-	else
-	{
-		// TODO proper error/warning handling
-	}
-	// TX_POWER (enabled smart transmit power control)
-	if (_channel == CHANNEL_1 || _channel == CHANNEL_2)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x15355575L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x75757575L, LEN_TX_POWER);
-			}
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x07274767L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x67676767L, LEN_TX_POWER);
-			}
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_channel == CHANNEL_3)
-	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x0F2F4F6FL, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x6F6F6F6FL, LEN_TX_POWER);
-			}
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x2B4B6B8BL, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x8B8B8B8BL, LEN_TX_POWER);
-			}
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
-	}
-	else if (_channel == CHANNEL_4)
+	setDataRate(profile.getDataRate());
+	setPulseFrequency(profile.getPulseFrequency());
+	setPreambleLength(profile.getPreambleLength());
+	_pacSize = profile.getPacSize();
+	// not setChannel(), it would pick its own preamble code
+	_chanctrl[0] = ((profile.getChannel() | (profile.getChannel() << 4)) & 0xFF);
+	_channel = profile.getChannel();
+	setPreambleCode(profile.getPreambleCode());
+	// setDataRate() selected the Decawave SFD for 110 and 850 kb/s
+	if (!profile.isNonStandardSfd())
 	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x1F1F3F5FL, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x5F5F5F5FL, LEN_TX_POWER);
-			}
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x3A5A7A9AL, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x9A9A9A9AL, LEN_TX_POWER);
-			}
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
+		setBit(_chanctrl, LEN_CHAN_CTRL, DWSFD_BIT, false);
+		setBit(_chanctrl, LEN_CHAN_CTRL, TNSSFD_BIT, false);
+		setBit(_chanctrl, LEN_CHAN_CTRL, RNSSFD_BIT, false);
 	}
-	else if (_channel == CHANNEL_5)
+	else if (profile.getDataRate() == TRX_RATE_6800KBPS)
 	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x0E082848L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x48484848L, LEN_TX_POWER);
-			}
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x25456585L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x85858585L, LEN_TX_POWER);
-			}
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
+		setBit(_chanctrl, LEN_CHAN_CTRL, DWSFD_BIT, true);
 	}
-	else if (_channel == CHANNEL_7)
+}
+
+RadioProfile DW1000::getModeProfile(const uint8_t mode[])
+{
+	uint8_t preambleCode = mode[1] == TX_PULSE_FREQ_64MHZ ? PREAMBLE_CODE_64MHZ_10 : PREAMBLE_CODE_16MHZ_4;
+	return RadioProfile(mode[0], mode[1], mode[2], preambleCode, getRecommendedPacSize(mode[2]), CHANNEL_5,
+						mode[0] != TRX_RATE_6800KBPS);
+}
+
+RadioProfile DW1000::getCurrentProfile()
+{
+	return RadioProfile(_dataRate, _pulseFrequency, _preambleLength, _preambleCode, _pacSize, _channel,
+						getBit(_chanctrl, LEN_CHAN_CTRL, DWSFD_BIT));
+}
+
+void DW1000::tune()
+{
+	writeTuneImage(computeTuneImage(getCurrentProfile(), _smartPower));
+	// Crystal calibration from OTP (if available), unless trimmed with setCrystalTrim()
+	if (!_crystalTrimmed)
 	{
-		if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x32527292L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0x92929292L, LEN_TX_POWER);
-			}
-		}
-		else if (_pulseFrequency == TX_PULSE_FREQ_64MHZ)
-		{
-			if (_smartPower)
-			{
-				writeValueToBytes(txpower, 0x5171B1D1L, LEN_TX_POWER);
-			}
-			else
-			{
-				writeValueToBytes(txpower, 0xD1D1D1D1L, LEN_TX_POWER);
-			}
-		}
-		else
-		{
-			// TODO proper error/warning handling
-		}
+		// No trim value available from OTP, use midrange value of 0x10
+		_crystalTrim = _calibration.xtalTrim == 0 ? 0x10 : _calibration.xtalTrim;
 	}
-	else
+	writeCrystalTrim();
+}
+
+void DW1000::setCrystalTrim(uint8_t trim)
+{
+	_crystalTrim = trim > CRYSTAL_TRIM_MAX ? CRYSTAL_TRIM_MAX : trim;
+	_crystalTrimmed = true;
+	writeCrystalTrim();
+}
+
+void DW1000::writeCrystalTrim()
+{
+	// the upper bits must keep their reserved value 0b011
+	uint8_t fsxtalt[LEN_FS_XTALT];
+	writeValueToBytes(fsxtalt, ((_crystalTrim & 0x1F) | 0x60), LEN_FS_XTALT);
+	writeBytes(FS_CTRL, FS_XTALT_SUB, fsxtalt, LEN_FS_XTALT);
+}
+
+void DW1000::writeTuneImage(const DW1000TuneImage &tuneImage)
+{
+	// writeBytes() takes mutable buffers
+	DW1000TuneImage image = tuneImage;
+	writeBytes(AGC_TUNE, AGC_TUNE1_SUB, image.agcTune1, LEN_AGC_TUNE1);
+	writeBytes(AGC_TUNE, AGC_TUNE2_SUB, image.agcTune2, LEN_AGC_TUNE2);
+	writeBytes(AGC_TUNE, AGC_TUNE3_SUB, image.agcTune3, LEN_AGC_TUNE3);
+	writeBytes(DRX_TUNE, DRX_TUNE0b_SUB, image.drxTune0b, LEN_DRX_TUNE0b);
+	writeBytes(DRX_TUNE, DRX_TUNE1a_SUB, image.drxTune1a, LEN_DRX_TUNE1a);
+	writeBytes(DRX_TUNE, DRX_TUNE1b_SUB, image.drxTune1b, LEN_DRX_TUNE1b);
+	writeBytes(DRX_TUNE, DRX_TUNE2_SUB, image.drxTune2, LEN_DRX_TUNE2);
+	writeBytes(DRX_TUNE, DRX_TUNE4H_SUB, image.drxTune4H, LEN_DRX_TUNE4H);
+	writeBytes(LDE_IF, LDE_CFG1_SUB, image.ldeCfg1, LEN_LDE_CFG1);
+	writeBytes(LDE_IF, LDE_CFG2_SUB, image.ldeCfg2, LEN_LDE_CFG2);
+	writeBytes(LDE_IF, LDE_REPC_SUB, image.ldeRepc, LEN_LDE_REPC);
+	writeBytes(TX_POWER, NO_SUB, image.txPower, LEN_TX_POWER);
+	writeBytes(RF_CONF, RF_RXCTRLH_SUB, image.rfRxCtrlH, LEN_RF_RXCTRLH);
+	writeBytes(RF_CONF, RF_TXCTRL_SUB, image.rfTxCtrl, LEN_RF_TXCTRL);
+	writeBytes(TX_CAL, TC_PGDELAY_SUB, image.tcPgDelay, LEN_TC_PGDELAY);
+	writeBytes(FS_CTRL, FS_PLLTUNE_SUB, image.fsPllTune, LEN_FS_PLLTUNE);
+	writeBytes(FS_CTRL, FS_PLLCFG_SUB, image.fsPllCfg, LEN_FS_PLLCFG);
+}
+
+void DW1000::switchMode(const DW1000TuneImage &image)
+{
+	idle();
+	// only the register caches, the tuning is taken from the image
+	enableProfile(image.profile);
+	useSmartPower(image.smartPower);
+	writeSystemConfigurationRegister();
+	writeChannelControlRegister();
+	writeTransmitFrameControlRegister();
+	writeTuneImage(image);
+}
+
+/* ###########################################################################
+ * #### Interrupt handling ###################################################
+ * ######################################################################### */
+void DW1000::onInterrupt()
+{
+	if (!_deferredInterrupts)
 	{
-		// TODO proper error/warning handling
+		handleInterrupt();
+		return;
 	}
-	// Crystal calibration from OTP (if available)
-	uint8_t buf_otp[4] = {};
-	readBytesOTP(0x01E, buf_otp);
-	if (buf_otp[0] == 0)
+	// no chip access here, the owner task handles it
+	_interruptPending = true;
+	if (_handleInterruptPending != nullptr)
 	{
-		// No trim value available from OTP, use midrange value of 0x10
-		writeValueToBytes(fsxtalt, ((0x10 & 0x1F) | 0x60), LEN_FS_XTALT);
+		_handleInterruptPending();
 	}
-	else
+}
+
+bool DW1000::serviceInterrupts()
+{
+	if (!_interruptPending)
 	{
-		writeValueToBytes(fsxtalt, ((buf_otp[0] & 0x1F) | 0x60), LEN_FS_XTALT);
-	}
-	// write configuration back to chip
-	writeBytes(AGC_TUNE, AGC_TUNE1_SUB, agctune1, LEN_AGC_TUNE1);
-	writeBytes(AGC_TUNE, AGC_TUNE2_SUB, agctune2, LEN_AGC_TUNE2);
-	writeBytes(AGC_TUNE, AGC_TUNE3_SUB, agctune3, LEN_AGC_TUNE3);
-	writeBytes(DRX_TUNE, DRX_TUNE0b_SUB, drxtune0b, LEN_DRX_TUNE0b);
-	writeBytes(DRX_TUNE, DRX_TUNE1a_SUB, drxtune1a, LEN_DRX_TUNE1a);
-	writeBytes(DRX_TUNE, DRX_TUNE1b_SUB, drxtune1b, LEN_DRX_TUNE1b);
-	writeBytes(DRX_TUNE, DRX_TUNE2_SUB, drxtune2, LEN_DRX_TUNE2);
-	writeBytes(DRX_TUNE, DRX_TUNE4H_SUB, drxtune4H, LEN_DRX_TUNE4H);
-	writeBytes(LDE_IF, LDE_CFG1_SUB, ldecfg1, LEN_LDE_CFG1);
-	writeBytes(LDE_IF, LDE_CFG2_SUB, ldecfg2, LEN_LDE_CFG2);
-	writeBytes(LDE_IF, LDE_REPC_SUB, lderepc, LEN_LDE_REPC);
-	writeBytes(TX_POWER, NO_SUB, txpower, LEN_TX_POWER);
-	writeBytes(RF_CONF, RF_RXCTRLH_SUB, rfrxctrlh, LEN_RF_RXCTRLH);
-	writeBytes(RF_CONF, RF_TXCTRL_SUB, rftxctrl, LEN_RF_TXCTRL);
-	writeBytes(TX_CAL, TC_PGDELAY_SUB, tcpgdelay, LEN_TC_PGDELAY);
-	writeBytes(FS_CTRL, FS_PLLTUNE_SUB, fsplltune, LEN_FS_PLLTUNE);
-	writeBytes(FS_CTRL, FS_PLLCFG_SUB, fspllcfg, LEN_FS_PLLCFG);
-	writeBytes(FS_CTRL, FS_XTALT_SUB, fsxtalt, LEN_FS_XTALT);
+		return false;
+	}
+	// cleared first, an interrupt raised meanwhile is serviced with the next call
+	_interruptPending = false;
+	handleInterrupt();
+	return true;
 }
 
-/* ###########################################################################
- * #### Interrupt handling ###################################################
- * ######################################################################### */
 void DW1000::handleInterrupt()
 {
 	// read current status and handle via callbacks
@@ -884,18 +568,23 @@ void DW1000::handleInterrupt()
 		if (_permanentReceive)
 		{
 			newReceive();
-			startReceive();
+			if (armReceiveWindow())
+			{
+				startReceive();
+			}
 		}
 	}
 	else if (isReceiveTimeout() && _handleReceiveTimeout != nullptr)
 	{
+		// the window was bounded on purpose, it is up to the handler to listen again
 		_handleReceiveTimeout();
 		clearReceiveStatus();
-		if (_permanentReceive)
-		{
-			newReceive();
-			startReceive();
-		}
+	}
+	else if (isReceiveDone() && _handleReceived != nullptr && _doubleBuffered)
+	{
+		// the receiver keeps running into the other buffer, no re-arm
+		receiveDoubleBuffered();
+		_handleReceived();
 	}
 	else if (isReceiveDone() && _handleReceived != nullptr)
 	{
@@ -904,11 +593,163 @@ void DW1000::handleInterrupt()
 		if (_permanentReceive)
 		{
 			newReceive();
-			startReceive();
+			if (armReceiveWindow())
+			{
+				startReceive();
+			}
 		}
 	}
 	// clear all status that is left unhandled
-	clearAllStatus();
+	if (_doubleBuffered)
+	{
+		// except the good frame bits, they belong to a buffer not delivered yet
+		uint8_t status[LEN_SYS_STATUS];
+		memset(status, 0xff, LEN_SYS_STATUS);
+		setBit(status, LEN_SYS_STATUS, RXDFR_BIT, false);
+		setBit(status, LEN_SYS_STATUS, RXFCG_BIT, false);
+		setBit(status, LEN_SYS_STATUS, LDEDONE_BIT, false);
+		writeBytes(SYS_STATUS, NO_SUB, status, LEN_SYS_STATUS);
+	}
+	else
+	{
+		clearAllStatus();
+	}
+}
+
+/* ###########################################################################
+ * #### Double buffered receive ##############################################
+ * ######################################################################### */
+
+void DW1000::receiveDoubleBuffered()
+{
+	// the host side buffer always holds the older frame, drain both if both are full
+	for (uint8_t i = 0; i < 2 && isReceiveDone(); i++)
+	{
+		captureReceivedFrame();
+		toggleReceiveBuffer();
+		readSystemEventStatusRegister();
+	}
+	if (getBit(_sysstatus, LEN_SYS_STATUS, RXOVRR_BIT))
+	{
+		// both buffers were full and a frame was lost, the receiver has to be restarted
+		_receiveOverruns++;
+		idle();
+		clearAllStatus();
+		if (_permanentReceive)
+		{
+			newReceive();
+			if (armReceiveWindow())
+			{
+				startReceive();
+			}
+		}
+	}
+}
+
+void DW1000::captureReceivedFrame()
+{
+	uint8_t next = (_rxQueueHead + 1) % RX_FRAME_QUEUE_SIZE;
+	if (next == _rxQueueTail)
+	{
+		// the host is too slow, drop the newest frame
+		_receiveOverruns++;
+		return;
+	}
+	DW1000ReceivedFrame &frame = _rxQueue[_rxQueueHead];
+	memcpy(frame.status, _sysstatus, LEN_SYS_STATUS);
+	readBytes(RX_FINFO, NO_SUB, frame.frameInfo, LEN_RX_FINFO);
+	readBytes(RX_TIME, NO_SUB, frame.time, LEN_RX_TIME);
+	readBytes(RX_FQUAL, NO_SUB, frame.quality, LEN_RX_FQUAL);
+	readBytes(DRX_TUNE, DRX_CAR_INT_SUB, frame.carrierIntegrator, LEN_DRX_CAR_INT);
+	uint16_t len = (((uint16_t)frame.frameInfo[1] << 8) | (uint16_t)frame.frameInfo[0]) & 0x03FF;
+	readBytes(RX_BUFFER, NO_SUB, frame.data, len < LEN_UWB_FRAMES ? len : LEN_UWB_FRAMES);
+	_rxQueueHead = next;
+}
+
+void DW1000::toggleReceiveBuffer()
+{
+	// hand the host side buffer back: clear its good frame status, then swap the buffers
+	uint8_t status[LEN_SYS_STATUS];
+	memset(status, 0, LEN_SYS_STATUS);
+	setBit(status, LEN_SYS_STATUS, RXDFR_BIT, true);
+	setBit(status, LEN_SYS_STATUS, RXFCG_BIT, true);
+	setBit(status, LEN_SYS_STATUS, LDEDONE_BIT, true);
+	writeBytes(SYS_STATUS, NO_SUB, status, LEN_SYS_STATUS);
+	writeByte(SYS_CTRL, HRBPT_BIT / 8, _BV(HRBPT_BIT % 8));
+}
+
+void DW1000::syncReceiveBufferPointers()
+{
+	// after a reset or TRXOFF the host and IC side pointers may disagree
+	readSystemEventStatusRegister();
+	if (getBit(_sysstatus, LEN_SYS_STATUS, HSRBP_BIT) != getBit(_sysstatus, LEN_SYS_STATUS, ICRBP_BIT))
+	{
+		writeByte(SYS_CTRL, HRBPT_BIT / 8, _BV(HRBPT_BIT % 8));
+	}
+}
+
+bool DW1000::nextReceivedFrame()
+{
+	if (_rxQueueTail == _rxQueueHead)
+	{
+		_rxFrameValid = false;
+		return false;
+	}
+	memcpy(&_rxFrame, &_rxQueue[_rxQueueTail], sizeof(DW1000ReceivedFrame));
+	_rxQueueTail = (_rxQueueTail + 1) % RX_FRAME_QUEUE_SIZE;
+	_rxFrameValid = true;
+	return true;
+}
+
+/*
+ * Read a register of the last received frame: from the chip, or from the frame made current
+ * by nextReceivedFrame() in double buffered mode.
+ */
+void DW1000::readReceiveBytes(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n)
+{
+	if (!_rxFrameValid)
+	{
+		readBytes(cmd, offset, data, n);
+		return;
+	}
+	const uint8_t *source;
+	uint16_t length;
+	if (cmd == RX_FINFO)
+	{
+		source = _rxFrame.frameInfo;
+		length = LEN_RX_FINFO;
+	}
+	else if (cmd == RX_TIME)
+	{
+		source = _rxFrame.time;
+		length = LEN_RX_TIME;
+	}
+	else if (cmd == RX_FQUAL)
+	{
+		source = _rxFrame.quality;
+		length = LEN_RX_FQUAL;
+	}
+	else if (cmd == DRX_TUNE && offset == DRX_CAR_INT_SUB)
+	{
+		source = _rxFrame.carrierIntegrator;
+		length = LEN_DRX_CAR_INT;
+		offset = 0;
+	}
+	else if (cmd == RX_BUFFER)
+	{
+		source = _rxFrame.data;
+		length = LEN_UWB_FRAMES;
+	}
+	else
+	{
+		readBytes(cmd, offset, data, n);
+		return;
+	}
+	memset(data, 0, n);
+	if (offset < length)
+	{
+		memcpy(data, source + offset, offset + n <= length ? n : length - offset);
+	}
 }
 
 /* ###########################################################################
@@ -1143,8 +984,8 @@ void DW1000::getTempAndVbat(float &temp, float &vbat)
 	readBytes(TX_CAL, 0x04, &sar_ltemp, 1);
 
 	// calculate voltage and temperature
-	vbat = (sar_lvbat - _vmeas3v3) / 173.0f + 3.3f;
-	temp = (sar_ltemp - _tmeas23C) * 1.14f + 23.0f;
+	vbat = (sar_lvbat - _calibration.vmeas3v3) / 173.0f + 3.3f;
+	temp = (sar_ltemp - _calibration.tmeas23C) * 1.14f + 23.0f;
 }
 
 void DW1000::setEUI(uint8_t eui[])
@@ -1197,6 +1038,10 @@ void DW1000::setFrameFilterAllowReserved(bool val)
 
 void DW1000::setDoubleBuffering(bool val)
 {
+	_doubleBuffered = val;
+	_rxQueueHead = 0;
+	_rxQueueTail = 0;
+	_rxFrameValid = false;
 	setBit(_syscfg, LEN_SYS_CFG, DIS_DRXB_BIT, !val);
 }
 
@@ -1232,6 +1077,7 @@ void DW1000::interruptOnReceiveFailed(bool val)
 void DW1000::interruptOnReceiveTimeout(bool val)
 {
 	setBit(_sysmask, LEN_SYS_MASK, RXRFTO_BIT, val);
+	setBit(_sysmask, LEN_SYS_MASK, RXPTO_BIT, val);
 }
 
 void DW1000::interruptOnReceiveTimestampAvailable(bool val)
@@ -1284,6 +1130,10 @@ void DW1000::newReceive()
 
 void DW1000::startReceive()
 {
+	if (_doubleBuffered)
+	{
+		syncReceiveBufferPointers();
+	}
 	setBit(_sysctrl, LEN_SYS_CTRL, SFCST_BIT, !_frameCheck);
 	setBit(_sysctrl, LEN_SYS_CTRL, RXENAB_BIT, true);
 	writeBytes(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
@@ -1303,7 +1153,13 @@ void DW1000::startTransmit()
 	setBit(_sysctrl, LEN_SYS_CTRL, SFCST_BIT, !_frameCheck);
 	setBit(_sysctrl, LEN_SYS_CTRL, TXSTRT_BIT, true);
 	writeBytes(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
-	if (_permanentReceive)
+	if (getBit(_sysctrl, LEN_SYS_CTRL, WAIT4RESP_BIT))
+	{
+		// the receiver is turned on by the chip after the response delay
+		memset(_sysctrl, 0, LEN_SYS_CTRL);
+		_deviceMode = RX_MODE;
+	}
+	else if (_permanentReceive && armReceiveWindow())
 	{
 		memset(_sysctrl, 0, LEN_SYS_CTRL);
 		_deviceMode = RX_MODE;
@@ -1337,7 +1193,14 @@ void DW1000::commitConfiguration()
 	tune();
 	// TODO check not larger two bytes integer
 	uint8_t antennaDelayBytes[DW1000Time::LENGTH_TIMESTAMP];
-	if (_antennaDelay.getTimestamp() == 0 && _antennaCalibrated == false)
+	// the factory value for the current pulse frequency, if programmed and not overridden
+	uint16_t factoryDelay = _pulseFrequency == TX_PULSE_FREQ_64MHZ ? _calibration.antennaDelay64MHz
+																   : _calibration.antennaDelay16MHz;
+	if (_antennaCalibrated == false && factoryDelay != 0 && factoryDelay != 0xFFFF)
+	{
+		_antennaDelay.setTimestamp(factoryDelay);
+	}
+	else if (_antennaDelay.getTimestamp() == 0 && _antennaCalibrated == false)
 	{
 		_antennaDelay.setTimestamp(16384);
 		_antennaCalibrated = true;
@@ -1348,6 +1211,86 @@ void DW1000::commitConfiguration()
 	writeBytes(LDE_IF, LDE_RXANTD_SUB, antennaDelayBytes, LEN_LDE_RXANTD);
 }
 
+/*
+ * The registers that tell whether the chip still runs the committed configuration: the
+ * register caches, a few tuned registers that depend on each part of the profile, and the
+ * antenna delays. TX_POWER and TC_PGDELAY are left out, high_power_init() overrides them.
+ */
+void DW1000::getConfigRegisters(ConfigRegister registers[], DW1000TuneImage &image, uint8_t antennaDelay[])
+{
+	static_assert(LEN_PANADR <= configRegisterMaxLength && LEN_SYS_CFG <= configRegisterMaxLength &&
+					  LEN_CHAN_CTRL <= configRegisterMaxLength && LEN_SYS_MASK <= configRegisterMaxLength &&
+					  LEN_AGC_TUNE1 <= configRegisterMaxLength && LEN_DRX_TUNE2 <= configRegisterMaxLength &&
+					  LEN_LDE_REPC <= configRegisterMaxLength && LEN_FS_PLLCFG <= configRegisterMaxLength &&
+					  LEN_TX_ANTD <= configRegisterMaxLength && LEN_LDE_RXANTD <= configRegisterMaxLength,
+				  "a configuration register is longer than configRegisterMaxLength");
+	registers[0] = {PANADR, NO_SUB, _networkAndAddress, LEN_PANADR, false};
+	registers[1] = {SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG, false};
+	registers[2] = {CHAN_CTRL, NO_SUB, _chanctrl, LEN_CHAN_CTRL, false};
+	registers[3] = {SYS_MASK, NO_SUB, _sysmask, LEN_SYS_MASK, false};
+	registers[4] = {AGC_TUNE, AGC_TUNE1_SUB, image.agcTune1, LEN_AGC_TUNE1, true};
+	registers[5] = {DRX_TUNE, DRX_TUNE2_SUB, image.drxTune2, LEN_DRX_TUNE2, true};
+	registers[6] = {LDE_IF, LDE_REPC_SUB, image.ldeRepc, LEN_LDE_REPC, true};
+	registers[7] = {FS_CTRL, FS_PLLCFG_SUB, image.fsPllCfg, LEN_FS_PLLCFG, true};
+	registers[8] = {TX_ANTD, NO_SUB, antennaDelay, LEN_TX_ANTD, false};
+	registers[9] = {LDE_IF, LDE_RXANTD_SUB, antennaDelay, LEN_LDE_RXANTD, false};
+}
+
+bool DW1000::warmRestart()
+{
+	idle();
+	uint8_t devId[LEN_DEV_ID] = {};
+	readBytes(DEV_ID, NO_SUB, devId, LEN_DEV_ID);
+	if (devId[3] != 0xDE || devId[2] != 0xCA)
+	{
+		return false;
+	}
+	ConfigRegister registers[configRegistersNumber];
+	DW1000TuneImage image = computeTuneImage(getCurrentProfile(), _smartPower);
+	uint8_t antennaDelayBytes[DW1000Time::LENGTH_TIMESTAMP];
+	_antennaDelay.getTimestamp(antennaDelayBytes);
+	getConfigRegisters(registers, image, antennaDelayBytes);
+
+	uint8_t actual[configRegistersNumber][configRegisterMaxLength];
+	for (uint8_t i = 0; i < configRegistersNumber; i++)
+	{
+		readBytes(registers[i].cmd, registers[i].offset, actual[i], registers[i].length);
+	}
+	_restoredRegisters = 0;
+	if (memcmp(actual[0], _networkAndAddress, LEN_PANADR) != 0)
+	{
+		// the address is back to its reset value, so is the LDE microcode
+		return false;
+	}
+	bool tuned = false;
+	for (uint8_t i = 1; i < configRegistersNumber; i++)
+	{
+		if (memcmp(actual[i], registers[i].expected, registers[i].length) == 0)
+		{
+			continue;
+		}
+		_restoredRegisters++;
+		if (registers[i].tuned)
+		{
+			// the registers not checked are likely off as well
+			tuned = true;
+			continue;
+		}
+		writeBytes(registers[i].cmd, registers[i].offset, registers[i].expected, registers[i].length);
+	}
+	if (tuned)
+	{
+		writeTuneImage(image);
+	}
+	if (_restoredRegisters > 0)
+	{
+		// not checked, written back with the others
+		writeTransmitFrameControlRegister();
+	}
+	clearAllStatus();
+	return true;
+}
+
 void DW1000::printSysStatus()
 {
 	uint8_t data[LEN_SYS_STATUS];
@@ -1364,6 +1307,20 @@ void DW1000::waitForResponse(bool val)
 	setBit(_sysctrl, LEN_SYS_CTRL, WAIT4RESP_BIT, val);
 }
 
+void DW1000::setResponseDelay(uint32_t timeUs)
+{
+	uint8_t ackrespt[LEN_ACK_RESP_T];
+	readBytes(ACK_RESP_T, NO_SUB, ackrespt, LEN_ACK_RESP_T);
+	// W4R_TIM is 20 bits wide, ACK_TIM in the last byte is kept
+	uint32_t units = (uint32_t)((uint64_t)timeUs * 4992 / 5120);
+	if (units > 0xFFFFF)
+		units = 0xFFFFF;
+	ackrespt[0] = units & 0xFF;
+	ackrespt[1] = (units >> 8) & 0xFF;
+	ackrespt[2] = (ackrespt[2] & 0xF0) | ((units >> 16) & 0x0F);
+	writeBytes(ACK_RESP_T, NO_SUB, ackrespt, LEN_ACK_RESP_T);
+}
+
 void DW1000::suppressFrameCheck(bool val)
 {
 	_frameCheck = !val;
@@ -1376,6 +1333,77 @@ void DW1000::useSmartPower(bool smartPower)
 }
 
 DW1000Time DW1000::setDelay(const DW1000Time &delay)
+{
+	if (_deviceMode == IDLE_MODE)
+	{
+		// in idle, ignore
+		return DW1000Time();
+	}
+	DW1000Time futureTime;
+	getSystemTimestamp(futureTime);
+	futureTime += delay;
+	return setDelayedTime(futureTime);
+}
+
+void DW1000::setPreambleDetectionTimeout(uint16_t pacs)
+{
+	uint8_t pretoc[LEN_DRX_PRETOC];
+	writeValueToBytes(pretoc, pacs, LEN_DRX_PRETOC);
+	writeBytes(DRX_TUNE, DRX_PRETOC_SUB, pretoc, LEN_DRX_PRETOC);
+}
+
+void DW1000::setFrameWaitTimeout(uint16_t timeUs)
+{
+	// the counter runs at 499.2 MHz / 512, i.e. ~1.026 us per unit
+	uint16_t units = (uint16_t)((uint32_t)timeUs * 4992 / 5120);
+	uint8_t fwto[LEN_RX_FWTO];
+	writeValueToBytes(fwto, units, LEN_RX_FWTO);
+	writeBytes(RX_FWTO, NO_SUB, fwto, LEN_RX_FWTO);
+	setBit(_syscfg, LEN_SYS_CFG, RXWTOE_BIT, units != 0);
+	writeSystemConfigurationRegister();
+	if (timeUs == 0)
+	{
+		_receiveWindowBounded = false;
+	}
+}
+
+void DW1000::setReceiveWindowEnd(const DW1000Time &end)
+{
+	_receiveWindowEnd.setTimestamp(end.getTimestamp() % DW1000Time::TIME_OVERFLOW);
+	_receiveWindowBounded = true;
+}
+
+bool DW1000::armReceiveWindow()
+{
+	if (!_receiveWindowBounded)
+	{
+		return true;
+	}
+	// the timeout counts from the RX enable, so each re-arm gets only what is left
+	DW1000Time now;
+	getSystemTimestamp(now);
+	int64_t left = (_receiveWindowEnd - now).wrap().getTimestamp();
+	float leftUs = DW1000Time(left).getAsMicroSeconds();
+	// over, or already past and wrapped to a huge rest (below 2 us the timeout would round to off)
+	if (left > DW1000Time::TIME_OVERFLOW / 2 || leftUs < 2)
+	{
+		_receiveWindowBounded = false;
+		if (_handleReceiveTimeout != nullptr)
+		{
+			_handleReceiveTimeout();
+		}
+		return false;
+	}
+	setFrameWaitTimeout(leftUs > 0xFFFF ? 0xFFFF : (uint16_t)leftUs);
+	return true;
+}
+
+/*
+ * Schedule the pending transmission/reception at an absolute system time (e.g. relative
+ * to a receive timestamp). The low 9 bits are ignored by the chip. The caller has to make
+ * sure the time is still in the future when the transceiver is started.
+ */
+DW1000Time DW1000::setDelayedTime(const DW1000Time &time)
 {
 	if (_deviceMode == TX_MODE)
 	{
@@ -1391,15 +1419,12 @@ DW1000Time DW1000::setDelay(const DW1000Time &delay)
 		return DW1000Time();
 	}
 	uint8_t delayBytes[5];
-	DW1000Time futureTime;
-	getSystemTimestamp(futureTime);
-	futureTime += delay;
-	futureTime.getTimestamp(delayBytes);
+	time.getTimestamp(delayBytes);
 	delayBytes[0] = 0;
 	delayBytes[1] &= 0xFE;
 	writeBytes(DX_TIME, NO_SUB, delayBytes, LEN_DX_TIME);
 	// adjust expected time with configured antenna delay
-	futureTime.setTimestamp(delayBytes);
+	DW1000Time futureTime(delayBytes);
 	futureTime += _antennaDelay;
 	return futureTime;
 }
@@ -1496,6 +1521,58 @@ void DW1000::setPreambleLength(uint8_t prealen)
 	_preambleLength = prealen;
 }
 
+void DW1000::setTransmitPreambleLength(uint8_t prealen)
+{
+	// written to the chip with the next transmission
+	prealen &= 0x0F;
+	_txfctrl[2] &= 0xC3;
+	_txfctrl[2] |= (uint8_t)((prealen << 2) & 0xFF);
+}
+
+uint16_t DW1000::getPreambleSymbols(uint8_t prealen)
+{
+	switch (prealen)
+	{
+	case TX_PREAMBLE_LEN_64:
+		return 64;
+	case TX_PREAMBLE_LEN_128:
+		return 128;
+	case TX_PREAMBLE_LEN_256:
+		return 256;
+	case TX_PREAMBLE_LEN_512:
+		return 512;
+	case TX_PREAMBLE_LEN_1024:
+		return 1024;
+	case TX_PREAMBLE_LEN_1536:
+		return 1536;
+	case TX_PREAMBLE_LEN_2048:
+		return 2048;
+	default:
+		return 4096;
+	}
+}
+
+void DW1000::setSniffMode(bool enable, uint8_t onTimePac, uint8_t offTimeUs)
+{
+	// the sniff sequencer runs on the second PLL
+	uint8_t pmscctrl0[LEN_PMSC_CTRL0];
+	memset(pmscctrl0, 0, LEN_PMSC_CTRL0);
+	readBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, LEN_PMSC_CTRL0);
+	setBit(pmscctrl0, LEN_PMSC_CTRL0, PLL2_SEQ_EN_BIT, enable);
+	writeBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, LEN_PMSC_CTRL0);
+
+	uint8_t rxsniff[LEN_RX_SNIFF];
+	memset(rxsniff, 0, LEN_RX_SNIFF);
+	if (enable)
+	{
+		// SNIFF_ONT (4 bits, in PACs), SNIFF_OFFT (8 bits, in us)
+		rxsniff[0] = onTimePac & 0x0F;
+		rxsniff[1] = offTimeUs;
+	}
+	writeBytes(RX_SNIFF, NO_SUB, rxsniff, LEN_RX_SNIFF);
+	_sniffMode = enable;
+}
+
 void DW1000::useExtendedFrameLength(bool val)
 {
 	_extendedFrameLength = (val ? FRAME_LENGTH_EXTENDED : FRAME_LENGTH_NORMAL);
@@ -1601,24 +1678,14 @@ void DW1000::setDefaults()
 		interruptOnSent(true);
 		interruptOnReceived(true);
 		interruptOnReceiveFailed(true);
+		// only fires when a window is bounded with setFrameWaitTimeout() or setPreambleDetectionTimeout()
+		interruptOnReceiveTimeout(true);
 		interruptOnReceiveTimestampAvailable(false);
 		interruptOnAutomaticAcknowledgeTrigger(true);
 		setReceiverAutoReenable(true);
 		// default mode when powering up the chip
 		// still explicitly selected for later tuning
-		enableMode(MODE_LONGDATA_RANGE_LOWPOWER);
-
-		// TODO add channel and code to mode tuples
-		// TODO add channel and code settings with checks (see DW1000 user manual 10.5 table 61)/
-		setChannel(CHANNEL_5);
-		if (getPulseFrequency() == TX_PULSE_FREQ_16MHZ)
-		{
-			setPreambleCode(PREAMBLE_CODE_16MHZ_4);
-		}
-		else
-		{
-			setPreambleCode(PREAMBLE_CODE_64MHZ_10);
-		}
+		enableProfile(PROFILE_LONGDATA_RANGE_LOWPOWER);
 	}
 }
 
@@ -1665,7 +1732,7 @@ uint16_t DW1000::getDataLength()
 	{
 		// 10 bits of RX frame control register
 		uint8_t rxFrameInfo[LEN_RX_FINFO] = {};
-		readBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
+		readReceiveBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
 		len = ((((uint16_t)rxFrameInfo[1] << 8) | (uint16_t)rxFrameInfo[0]) & 0x03FF);
 	}
 	if (_frameCheck && len > 2)
@@ -1681,7 +1748,7 @@ void DW1000::getData(uint8_t data[], uint16_t n)
 	{
 		return;
 	}
-	readBytes(RX_BUFFER, NO_SUB, data, n);
+	readReceiveBytes(RX_BUFFER, NO_SUB, data, n);
 }
 
 void DW1000::getData(std::string &data)
@@ -1714,7 +1781,7 @@ void DW1000::getTransmitTimestamp(DW1000Time &time)
 void DW1000::getReceiveTimestamp(DW1000Time &time)
 {
 	uint8_t rxTimeBytes[LEN_RX_STAMP];
-	readBytes(RX_TIME, RX_STAMP_SUB, rxTimeBytes, LEN_RX_STAMP);
+	readReceiveBytes(RX_TIME, RX_STAMP_SUB, rxTimeBytes, LEN_RX_STAMP);
 	time.setTimestamp(rxTimeBytes);
 	// correct timestamp (i.e. consider range bias)
 	correctTimestamp(time);
@@ -1805,7 +1872,7 @@ void DW1000::getTransmitTimestamp(uint8_t data[])
 
 void DW1000::getReceiveTimestamp(uint8_t data[])
 {
-	readBytes(RX_TIME, RX_STAMP_SUB, data, LEN_RX_STAMP);
+	readReceiveBytes(RX_TIME, RX_STAMP_SUB, data, LEN_RX_STAMP);
 }
 
 void DW1000::getSystemTimestamp(uint8_t data[])
@@ -1846,10 +1913,11 @@ bool DW1000::isReceiveFailed()
 	return false;
 }
 
-// Checks to see any of the three timeout bits in sysstatus are high (RXRFTO (Frame Wait timeout), RXPTO (Preamble timeout), RXSFDTO (Start frame delimiter(?) timeout).
+// Checks to see the timeout bits in sysstatus are high (RXRFTO (Frame Wait timeout), RXPTO (Preamble timeout)).
+// RXSFDTO (Start frame delimiter timeout) is a reception error the receiver recovers from on its own (RXAUTR).
 bool DW1000::isReceiveTimeout()
 {
-	return (getBit(_sysstatus, LEN_SYS_STATUS, RXRFTO_BIT) | getBit(_sysstatus, LEN_SYS_STATUS, RXPTO_BIT) | getBit(_sysstatus, LEN_SYS_STATUS, RXSFDTO_BIT));
+	return (getBit(_sysstatus, LEN_SYS_STATUS, RXRFTO_BIT) | getBit(_sysstatus, LEN_SYS_STATUS, RXPTO_BIT));
 }
 
 bool DW1000::isClockProblem()
@@ -1905,8 +1973,8 @@ float DW1000::getReceiveQuality()
 	uint8_t noiseBytes[LEN_STD_NOISE] = {};
 	uint8_t fpAmpl2Bytes[LEN_FP_AMPL2] = {};
 	uint16_t noise, f2;
-	readBytes(RX_FQUAL, STD_NOISE_SUB, noiseBytes, LEN_STD_NOISE);
-	readBytes(RX_FQUAL, FP_AMPL2_SUB, fpAmpl2Bytes, LEN_FP_AMPL2);
+	readReceiveBytes(RX_FQUAL, STD_NOISE_SUB, noiseBytes, LEN_STD_NOISE);
+	readReceiveBytes(RX_FQUAL, FP_AMPL2_SUB, fpAmpl2Bytes, LEN_FP_AMPL2);
 	noise = (uint16_t)noiseBytes[0] | ((uint16_t)noiseBytes[1] << 8);
 	f2 = (uint16_t)fpAmpl2Bytes[0] | ((uint16_t)fpAmpl2Bytes[1] << 8);
 	return (float)f2 / noise;
@@ -1920,10 +1988,10 @@ float DW1000::getFirstPathPower()
 	uint8_t rxFrameInfo[LEN_RX_FINFO] = {};
 	uint16_t f1, f2, f3, N;
 	float A, corrFac;
-	readBytes(RX_TIME, FP_AMPL1_SUB, fpAmpl1Bytes, LEN_FP_AMPL1);
-	readBytes(RX_FQUAL, FP_AMPL2_SUB, fpAmpl2Bytes, LEN_FP_AMPL2);
-	readBytes(RX_FQUAL, FP_AMPL3_SUB, fpAmpl3Bytes, LEN_FP_AMPL3);
-	readBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
+	readReceiveBytes(RX_TIME, FP_AMPL1_SUB, fpAmpl1Bytes, LEN_FP_AMPL1);
+	readReceiveBytes(RX_FQUAL, FP_AMPL2_SUB, fpAmpl2Bytes, LEN_FP_AMPL2);
+	readReceiveBytes(RX_FQUAL, FP_AMPL3_SUB, fpAmpl3Bytes, LEN_FP_AMPL3);
+	readReceiveBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
 	f1 = (uint16_t)fpAmpl1Bytes[0] | ((uint16_t)fpAmpl1Bytes[1] << 8);
 	f2 = (uint16_t)fpAmpl2Bytes[0] | ((uint16_t)fpAmpl2Bytes[1] << 8);
 	f3 = (uint16_t)fpAmpl3Bytes[0] | ((uint16_t)fpAmpl3Bytes[1] << 8);
@@ -1958,8 +2026,8 @@ float DW1000::getReceivePower()
 	uint32_t twoPower17 = 131072;
 	uint16_t C, N;
 	float A, corrFac;
-	readBytes(RX_FQUAL, CIR_PWR_SUB, cirPwrBytes, LEN_CIR_PWR);
-	readBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
+	readReceiveBytes(RX_FQUAL, CIR_PWR_SUB, cirPwrBytes, LEN_CIR_PWR);
+	readReceiveBytes(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
 	C = (uint16_t)cirPwrBytes[0] | ((uint16_t)cirPwrBytes[1] << 8);
 	N = (((uint16_t)rxFrameInfo[2] >> 4) & 0xFF) | ((uint16_t)rxFrameInfo[3] << 4);
 	if (_pulseFrequency == TX_PULSE_FREQ_16MHZ)
@@ -1985,6 +2053,150 @@ float DW1000::getReceivePower()
 	return estRxPwr;
 }
 
+/*
+ * Read the carrier recovery integrator (DRX_CAR_INT) of the last received frame.
+ * The register is a 21 bit two's complement value, so it is sign extended here.
+ * It is only valid right after reception, before the receiver is re-enabled.
+ */
+int32_t DW1000::getCarrierIntegrator()
+{
+	uint8_t carIntBytes[LEN_DRX_CAR_INT] = {};
+	readReceiveBytes(DRX_TUNE, DRX_CAR_INT_SUB, carIntBytes, LEN_DRX_CAR_INT);
+	int32_t carInt = (int32_t)carIntBytes[0] | ((int32_t)carIntBytes[1] << 8) | ((int32_t)(carIntBytes[2] & 0x1F) << 16);
+	if (carInt & 0x100000)
+	{
+		carInt -= 0x200000;
+	}
+	return carInt;
+}
+
+/*
+ * Estimate the clock offset of the remote transmitter of the last received frame,
+ * in ppm, from the carrier recovery integrator (see section 8.2 of the user manual).
+ * A positive value means the remote clock runs faster than the local one.
+ */
+float DW1000::getClockOffset()
+{
+	// frequency offset [Hz] per integrator unit, depends on the data rate
+	float freqOffsetMultiplier;
+	if (_dataRate == TRX_RATE_110KBPS)
+	{
+		freqOffsetMultiplier = 998.4e6f / 2.0f / 8192.0f / 131072.0f;
+	}
+	else
+	{
+		freqOffsetMultiplier = 998.4e6f / 2.0f / 1024.0f / 131072.0f;
+	}
+	// carrier frequency of the channel in use
+	float carrierFrequency;
+	if (_channel == CHANNEL_1)
+	{
+		carrierFrequency = 3494.4e6f;
+	}
+	else if (_channel == CHANNEL_2 || _channel == CHANNEL_4)
+	{
+		carrierFrequency = 3993.6e6f;
+	}
+	else if (_channel == CHANNEL_3)
+	{
+		carrierFrequency = 4492.8e6f;
+	}
+	else
+	{
+		carrierFrequency = 6489.6e6f;
+	}
+	return -(float)getCarrierIntegrator() * freqOffsetMultiplier * 1.0e6f / carrierFrequency;
+}
+
+uint16_t DW1000::getFirstPathIndex()
+{
+	uint8_t fpIndexBytes[LEN_FP_INDEX] = {};
+	readReceiveBytes(RX_TIME, FP_INDEX_SUB, fpIndexBytes, LEN_FP_INDEX);
+	return (uint16_t)fpIndexBytes[0] | ((uint16_t)fpIndexBytes[1] << 8);
+}
+
+uint16_t DW1000::readCIR(int16_t samples[], uint16_t count, uint16_t before, uint8_t decimation)
+{
+	// 10.6 fixed point, the window starts at the sample holding the first path
+	uint16_t firstPath = getFirstPathIndex() >> 6;
+	return readAccumulator(samples, firstPath > before ? firstPath - before : 0, count, decimation);
+}
+
+uint16_t DW1000::readAccumulator(int16_t samples[], uint16_t index, uint16_t count, uint8_t decimation)
+{
+	if (decimation == 0)
+	{
+		decimation = 1;
+	}
+	// every sample of either PRF lies within the accumulator memory
+	static_assert(ACC_SAMPLES_16MHZ * LEN_ACC_SAMPLE <= LEN_ACC_MEM && ACC_SAMPLES_64MHZ * LEN_ACC_SAMPLE <= LEN_ACC_MEM,
+				  "accumulator samples past LEN_ACC_MEM");
+	uint16_t length = getAccumulatorLength();
+	if (index >= length || count == 0)
+	{
+		return 0;
+	}
+	if (index + (uint32_t)(count - 1) * decimation >= length)
+	{
+		count = (length - 1 - index) / decimation + 1;
+	}
+	uint16_t n = getCIRReadBytes(count, decimation);
+
+	// the accumulator needs its clock and the RX clock forced on while it is read, see 7.2.47
+	uint8_t pmscctrl0[LEN_PMSC_CTRL0] = {};
+	readBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, LEN_PMSC_CTRL0);
+	uint8_t accctrl0[LEN_PMSC_CTRL0];
+	memcpy(accctrl0, pmscctrl0, LEN_PMSC_CTRL0);
+	accctrl0[0] &= ~(0x03 << RXCLKS_BIT);
+	accctrl0[0] |= PLL_CLOCK << RXCLKS_BIT;
+	setBit(accctrl0, LEN_PMSC_CTRL0, FACE_BIT, 1);
+	setBit(accctrl0, LEN_PMSC_CTRL0, AMCE_BIT, 1);
+	writeBytes(PMSC, PMSC_CTRL0_SUB, accctrl0, 2);
+	uint8_t *raw = (uint8_t *)samples;
+	readBytes(ACC_MEM, index * LEN_ACC_SAMPLE, raw, n);
+	writeBytes(PMSC, PMSC_CTRL0_SUB, pmscctrl0, 2);
+
+	// drop the dummy byte and the decimated samples, the write position never passes the read position
+	for (uint16_t i = 0; i < count; i++)
+	{
+		const uint8_t *sample = raw + 1 + (uint32_t)i * decimation * LEN_ACC_SAMPLE;
+		int16_t real = (int16_t)((uint16_t)sample[0] | ((uint16_t)sample[1] << 8));
+		int16_t imaginary = (int16_t)((uint16_t)sample[2] | ((uint16_t)sample[3] << 8));
+		samples[2 * i] = real;
+		samples[2 * i + 1] = imaginary;
+	}
+	return count;
+}
+
+uint32_t DW1000::getFrameDurationUs(uint16_t n)
+{
+	// the preamble actually sent, see setTransmitPreambleLength()
+	uint16_t preambleSymbols = getPreambleSymbols((_txfctrl[2] >> 2) & 0x0F);
+	// preamble and SFD symbol duration [ns]
+	float symbolNs = _pulseFrequency == TX_PULSE_FREQ_64MHZ ? 1017.63f : 993.59f;
+	uint16_t sfdSymbols = _dataRate == TRX_RATE_110KBPS ? 64 : 8;
+	// PHR is sent at 850 kb/s, or at 110 kb/s in 110 kb/s mode [ns per bit]
+	float phrBitNs = _dataRate == TRX_RATE_110KBPS ? 8205.13f : 1025.64f;
+	float dataBitNs;
+	if (_dataRate == TRX_RATE_110KBPS)
+	{
+		dataBitNs = 8205.13f;
+	}
+	else if (_dataRate == TRX_RATE_850KBPS)
+	{
+		dataBitNs = 1025.64f;
+	}
+	else
+	{
+		dataBitNs = 128.21f;
+	}
+	// payload bits with the Reed-Solomon parity, 48 bits per block of 330
+	uint32_t dataBits = (uint32_t)n * 8;
+	dataBits += 48 * ((dataBits + 329) / 330);
+	float durationNs = (preambleSymbols + sfdSymbols) * symbolNs + 21 * phrBitNs + dataBits * dataBitNs;
+	return (uint32_t)(durationNs / 1000.0f);
+}
+
 /* ###########################################################################
  * #### Helper functions #####################################################
  * ######################################################################### */
@@ -2096,23 +2308,26 @@ void DW1000::readBytes(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n)
 	_portable.dw1000_spi_read(header, headerLen, data, n);
 }
 
-// always 4 bytes
+// always 4 bytes per word, the read mode stays enabled for the whole batch
 // TODO why always 4 bytes? can be different, see p. 58 table 10 otp memory map
-void DW1000::readBytesOTP(uint16_t address, uint8_t data[])
+void DW1000::readBytesOTP(const uint16_t addresses[], uint8_t data[][LEN_OTP_RDAT], uint8_t n)
 {
 	uint8_t addressBytes[LEN_OTP_ADDR];
 
 	// p60 - 6.3.3 Reading a value from OTP memory
-	// bytes of address
-	addressBytes[0] = (address & 0xFF);
-	addressBytes[1] = ((address >> 8) & 0xFF);
-	// set address
-	writeBytes(OTP_IF, OTP_ADDR_SUB, addressBytes, LEN_OTP_ADDR);
-	// switch into read mode
-	writeByte(OTP_IF, OTP_CTRL_SUB, 0x03); // OTPRDEN | OTPREAD
-	writeByte(OTP_IF, OTP_CTRL_SUB, 0x01); // OTPRDEN
-	// read value/block - 4 bytes
-	readBytes(OTP_IF, OTP_RDAT_SUB, data, LEN_OTP_RDAT);
+	for (uint8_t i = 0; i < n; i++)
+	{
+		// bytes of address
+		addressBytes[0] = (addresses[i] & 0xFF);
+		addressBytes[1] = ((addresses[i] >> 8) & 0xFF);
+		// set address
+		writeBytes(OTP_IF, OTP_ADDR_SUB, addressBytes, LEN_OTP_ADDR);
+		// switch into read mode
+		writeByte(OTP_IF, OTP_CTRL_SUB, 0x03); // OTPRDEN | OTPREAD
+		writeByte(OTP_IF, OTP_CTRL_SUB, 0x01); // OTPRDEN
+		// read value/block - 4 bytes
+		readBytes(OTP_IF, OTP_RDAT_SUB, data[i], LEN_OTP_RDAT);
+	}
 	// end read mode
 	writeByte(OTP_IF, OTP_CTRL_SUB, 0x00);
 }
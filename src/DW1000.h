@@ -16,6 +16,117 @@
 #define _BV(a) (1 << a)
 #endif
 
+// frames of the double buffered receiver waiting for the host
+#define RX_FRAME_QUEUE_SIZE 4
+
+// one frame of the double buffered receiver, captured before its buffer is handed back to the chip
+struct DW1000ReceivedFrame
+{
+	uint8_t status[LEN_SYS_STATUS];
+	uint8_t frameInfo[LEN_RX_FINFO];
+	uint8_t time[LEN_RX_TIME];
+	uint8_t quality[LEN_RX_FQUAL];
+	uint8_t carrierIntegrator[LEN_DRX_CAR_INT];
+	uint8_t data[LEN_UWB_FRAMES];
+};
+
+// steps of the chip bring-up, see DW1000::beginAsync()
+enum class BringUpStep : uint8_t
+{
+	NONE,
+	SETTLE,		   // power up / wake up
+	CLOCK,		   // clocks to auto
+	RESET,		   // reset line driven low
+	RESET_RELEASE, // reset line released, chip start up
+	CONFIGURE,	   // default configuration, clocks to crystal
+	LDE_LOAD,	   // LDE microcode upload
+	LDE_DONE,
+	CLOCK_AUTO,	   // clocks back to auto (PLL)
+	OTP,		   // device check (the OTP calibration is read with the LDE upload)
+	DONE,
+	FAILED,		   // over, but the chip did not answer with its device identifier
+};
+
+// factory calibration values from OTP, read once and kept across reselects
+struct DW1000Calibration
+{
+	bool loaded;
+	// EUI in the byte order of setEUI(), all zero if not programmed
+	uint8_t eui[LEN_EUI];
+	uint8_t ldoTune[LEN_OTP_RDAT];
+	// SAR readings at 3.3 V and 23 C
+	uint8_t vmeas3v3;
+	uint8_t tmeas23C;
+	// 0 if not programmed
+	uint16_t antennaDelay16MHz;
+	uint16_t antennaDelay64MHz;
+	uint8_t xtalTrim;
+};
+
+class RadioProfile;
+template <uint8_t dataRate, uint8_t pulseFrequency, uint8_t preambleLength, uint8_t channel, uint8_t preambleCode, uint8_t pacSize, bool nonStandardSfd>
+constexpr RadioProfile makeRadioProfile();
+
+/*
+ * Complete radio configuration. Only makeRadioProfile(), which validates it at compile time, and the
+ * driver itself (the pre-defined modes, the current configuration) can build one, so a profile handed
+ * to DW1000::enableProfile() or DW1000Ranging::init() is always valid.
+ */
+class RadioProfile
+{
+public:
+	constexpr uint8_t getDataRate() const { return _dataRate; }
+	constexpr uint8_t getPulseFrequency() const { return _pulseFrequency; }
+	constexpr uint8_t getPreambleLength() const { return _preambleLength; }
+	constexpr uint8_t getPreambleCode() const { return _preambleCode; }
+	constexpr uint8_t getPacSize() const { return _pacSize; }
+	constexpr uint8_t getChannel() const { return _channel; }
+	// Decawave SFD instead of the IEEE 802.15.4 one
+	constexpr bool isNonStandardSfd() const { return _nonStandardSfd; }
+
+private:
+	constexpr RadioProfile(uint8_t dataRate, uint8_t pulseFrequency, uint8_t preambleLength, uint8_t preambleCode, uint8_t pacSize, uint8_t channel, bool nonStandardSfd)
+		: _dataRate(dataRate), _pulseFrequency(pulseFrequency), _preambleLength(preambleLength), _preambleCode(preambleCode), _pacSize(pacSize), _channel(channel), _nonStandardSfd(nonStandardSfd) {}
+
+	template <uint8_t dataRate, uint8_t pulseFrequency, uint8_t preambleLength, uint8_t channel, uint8_t preambleCode, uint8_t pacSize, bool nonStandardSfd>
+	friend constexpr RadioProfile makeRadioProfile();
+	friend class DW1000;
+
+	uint8_t _dataRate;
+	uint8_t _pulseFrequency;
+	uint8_t _preambleLength;
+	uint8_t _preambleCode;
+	uint8_t _pacSize;
+	uint8_t _channel;
+	bool _nonStandardSfd;
+};
+
+// values of all registers tuned for one profile, computed by DW1000::computeTuneImage()
+struct DW1000TuneImage
+{
+	// configuration the image was computed for
+	RadioProfile profile;
+	bool smartPower;
+	// register bytes, in chip (little endian) order
+	uint8_t agcTune1[LEN_AGC_TUNE1];
+	uint8_t agcTune2[LEN_AGC_TUNE2];
+	uint8_t agcTune3[LEN_AGC_TUNE3];
+	uint8_t drxTune0b[LEN_DRX_TUNE0b];
+	uint8_t drxTune1a[LEN_DRX_TUNE1a];
+	uint8_t drxTune1b[LEN_DRX_TUNE1b];
+	uint8_t drxTune2[LEN_DRX_TUNE2];
+	uint8_t drxTune4H[LEN_DRX_TUNE4H];
+	uint8_t ldeCfg1[LEN_LDE_CFG1];
+	uint8_t ldeCfg2[LEN_LDE_CFG2];
+	uint8_t ldeRepc[LEN_LDE_REPC];
+	uint8_t txPower[LEN_TX_POWER];
+	uint8_t rfRxCtrlH[LEN_RF_RXCTRLH];
+	uint8_t rfTxCtrl[LEN_RF_TXCTRL];
+	uint8_t tcPgDelay[LEN_TC_PGDELAY];
+	uint8_t fsPllCfg[LEN_FS_PLLCFG];
+	uint8_t fsPllTune[LEN_FS_PLLTUNE];
+};
+
 class DW1000
 {
 public:
@@ -43,6 +154,19 @@ public:
 	*/
 	void select();
 
+	/**
+	Non blocking variant of `begin()`: the same bring-up as a state machine that never waits. Call
+	`serviceBringUp()` until it returns false (e.g. from the main loop, while other peripherals are
+	initialized), handleReady is called with the result once the chip is up.
+	*/
+	void beginAsync(std::function<void(bool)> handleReady);
+	// runs the next bring-up step if its time has come, returns false once done (or not started)
+	bool serviceBringUp();
+	// true once the bring-up succeeded, false while it runs or after it failed
+	bool isReady() { return _bringUpStep == BringUpStep::DONE; }
+	// time [ms] spent in a step of the last asynchronous bring-up, including its wait
+	uint32_t getBringUpStepTime(BringUpStep step) { return _bringUpTimes[(uint8_t)step]; }
+
 	/**
 	Tells the driver library that no communication to a DW1000 will be required anymore.
 	This basically just frees SPI and the previously used pins.
@@ -74,6 +198,29 @@ public:
 	*/
 	void spiWakeup();
 
+	/**
+	Brings the chip back to idle after `spiWakeup()`. The configuration saved by `deepSleep()` is
+	uploaded from the AON block by the chip itself, so no `select()` or `tune()` is needed; only
+	what the AON block does not hold is written again.
+
+	@return false if the chip did not answer, a full `select()` and configuration is needed then.
+	*/
+	bool restoreFromSleep();
+
+	/**
+	Warm restart after a soft fault: verifies the key configuration registers against the
+	current configuration and restores only the ones that differ, without reset and LDE reload.
+
+	On the host benchmark (test/RecoveryBenchmark.cpp) it takes 13 SPI transfers, 33 us on the bus at
+	16 MHz, when nothing was lost and 74 us when the tuning has to be rewritten. A chip reset with
+	`select()` and the configuration takes 37.3 ms, almost all of it waiting on the chip.
+
+	@return false if the chip lost its state (no answer or reset), a full `select()` and configuration is needed then.
+	*/
+	bool warmRestart();
+	// registers the last warmRestart() had to write back
+	uint8_t getRestoredRegisters() { return _restoredRegisters; }
+
 	/**
 	Resets all connected or the currently selected DW1000 chip. A hard reset of all chips
 	is preferred, although a soft reset of the currently selected one is executed if no
@@ -208,12 +355,38 @@ public:
 	void setPulseFrequency(uint8_t freq);
 	uint8_t getPulseFrequency();
 	void setPreambleLength(uint8_t prealen);
+	// preamble of the frames sent only, the receiver keeps the tuning of setPreambleLength()
+	void setTransmitPreambleLength(uint8_t prealen);
+	static uint16_t getPreambleSymbols(uint8_t prealen);
 	void setChannel(uint8_t channel);
 	void setPreambleCode(uint8_t preacode);
 	void useSmartPower(bool smartPower);
 
 	/* transmit and receive configuration. */
 	DW1000Time setDelay(const DW1000Time &delay);
+	DW1000Time setDelayedTime(const DW1000Time &time);
+	/* bounded receive windows, 0 disables the timeout. An expired window raises the receive
+	   timeout interrupt and leaves the receiver off, even with permanent receive. */
+	void setPreambleDetectionTimeout(uint16_t pacs);
+	void setFrameWaitTimeout(uint16_t timeUs);
+	/* window ending at an absolute chip time: with permanent receive, the receiver is re-armed after a
+	   frame only for the rest of the window, and not at all once it is over (reported as receive
+	   timeout). Ended by setFrameWaitTimeout(0). */
+	void setReceiveWindowEnd(const DW1000Time &end);
+	/* double buffered receive: the chip receives into one buffer while the host reads the other.
+	   Frames are captured in the interrupt handler and delivered in order of arrival, the
+	   getters (data, timestamp, quality ...) refer to the frame made current by nextReceivedFrame(). */
+	void setDoubleBuffering(bool val);
+	bool isDoubleBuffered() { return _doubleBuffered; }
+	bool nextReceivedFrame();
+	uint8_t getReceivedFramesNumber() { return (uint8_t)((_rxQueueHead - _rxQueueTail + RX_FRAME_QUEUE_SIZE) % RX_FRAME_QUEUE_SIZE); }
+	// frames lost because both chip buffers or the queue were full
+	uint32_t getReceiveOverruns() { return _receiveOverruns; }
+
+	/* wait for response: the chip turns the receiver on by itself, setResponseDelay() after the end
+	   of the next transmission. To be set between newTransmit() and startTransmit(). */
+	void waitForResponse(bool val);
+	void setResponseDelay(uint32_t timeUs);
 	void receivePermanently(bool val);
 	void setData(uint8_t data[], uint16_t n);
 	void setData(const std::string &data);
@@ -232,6 +405,53 @@ public:
 	float getFirstPathPower();
 	float getReceiveQuality();
 
+	/* clock offset estimation from the carrier recovery integrator. */
+	int32_t getCarrierIntegrator();
+	float getClockOffset();
+
+	/**
+	Channel impulse response of the last received frame, read from the accumulator memory. It has to be
+	read before the receiver is enabled again, in double buffered mode it belongs to the latest frame.
+
+	`readCIR()` reads a window of `count` samples starting `before` samples ahead of the first path, keeping
+	one sample out of `decimation`. The samples are written as interleaved real/imaginary int16 pairs.
+	The whole window is read in one SPI burst straight into the caller buffer and packed in place, so the
+	buffer must hold getCIRReadBytes(count, decimation) bytes, of which the first 4 * count are the result.
+
+	SPI cost per window: 3 header bytes, 1 dummy byte and 4 bytes per sample of the undecimated span, plus
+	the first path index and three PMSC_CTRL0 accesses to gate the accumulator clock, 5 transfers in all.
+	On the host benchmark (test/CIRBenchmark.cpp) 64 samples take 278 bytes, 139 us at 16 MHz, and 530 or
+	1034 bytes with a decimation of 2 or 4: decimation saves buffer space, not bus time.
+
+	@return the number of samples written, less than count at the end of the accumulator.
+	*/
+	uint16_t readCIR(int16_t samples[], uint16_t count, uint16_t before = 8, uint8_t decimation = 1);
+	// same, from an absolute accumulator index
+	uint16_t readAccumulator(int16_t samples[], uint16_t index, uint16_t count, uint8_t decimation = 1);
+	static constexpr uint32_t getCIRReadBytes(uint16_t count, uint8_t decimation)
+	{
+		return count == 0 ? 0 : 1 + LEN_ACC_SAMPLE * ((uint32_t)(count - 1) * (decimation > 0 ? decimation : 1) + 1);
+	}
+	// first path index in the accumulator, in 1/64 samples
+	uint16_t getFirstPathIndex();
+	uint16_t getAccumulatorLength() { return _pulseFrequency == TX_PULSE_FREQ_16MHZ ? ACC_SAMPLES_16MHZ : ACC_SAMPLES_64MHZ; }
+
+	/* crystal trim (FS_XTALT), the OTP value unless set, a higher trim slows the clock down. */
+	static constexpr uint8_t CRYSTAL_TRIM_MAX = 0x1F;
+	static constexpr float CRYSTAL_TRIM_PPM = 1.5f; // approximate clock change per step
+	void setCrystalTrim(uint8_t trim);
+	uint8_t getCrystalTrim() { return _crystalTrim; }
+
+	/* air time of a frame of n bytes with the current mode, in microseconds. */
+	uint32_t getFrameDurationUs(uint16_t n);
+	/* after startTransmit(): the receiver comes on once the frame is out (permanent receive or WAIT4RESP). */
+	bool isReceiverEnabled() { return _deviceMode == RX_MODE; }
+
+	/* preamble sniff mode: the receiver listens for onTimePac PACs (1..15) every offTimeUs, and stays
+	   on once a preamble is detected. The senders need preambles long enough to span a sniff period. */
+	void setSniffMode(bool enable, uint8_t onTimePac = 2, uint8_t offTimeUs = 128);
+	bool isSniffMode() { return _sniffMode; }
+
 	/* interrupt management. */
 	void interruptOnSent(bool val);
 	void interruptOnReceived(bool val);
@@ -244,6 +464,12 @@ public:
 	void setAntennaDelay(const uint16_t value);
 	uint16_t getAntennaDelay();
 
+	/**
+	Factory calibration read from OTP during the bring-up. Unless set with `setAntennaDelay()`,
+	the antenna delay programmed for the current pulse frequency is used, if any.
+	*/
+	const DW1000Calibration &getCalibration() { return _calibration; }
+
 	/* callback handler management. */
 	void attachErrorHandler(std::function<void()> handleError)
 	{
@@ -275,6 +501,19 @@ public:
 		_handleReceiveTimestampAvailable = handleReceiveTimestampAvailable;
 	}
 
+	// called from the interrupt task when an interrupt was deferred, e.g. to wake up the owner task
+	void attachInterruptPendingHandler(std::function<void()> handleInterruptPending)
+	{
+		_handleInterruptPending = handleInterruptPending;
+	}
+
+	/* deferred interrupts: the interrupt task only flags the interrupt, the chip is then accessed
+	   by a single owner task only, the one calling serviceInterrupts() and all other functions. */
+	void setDeferredInterrupts(bool val) { _deferredInterrupts = val; }
+	bool isInterruptPending() { return _interruptPending; }
+	// run the handlers of a pending interrupt, returns false if there was none
+	bool serviceInterrupts();
+
 	/* device state management. */
 	// idle state
 	void idle();
@@ -319,6 +558,42 @@ public:
 	*/
 	void enableMode(const uint8_t mode[]);
 
+	/**
+	Applies a complete radio configuration (see `makeRadioProfile()`), including channel and
+	preamble code. The profile was validated when it was built, no checks are done here.
+	*/
+	void enableProfile(const RadioProfile &profile);
+
+	// the profile used by the pre-defined modes, on the default channel 5
+	static RadioProfile getModeProfile(const uint8_t mode[]);
+
+	/* profile validation (see DW1000 user manual 10.5 table 61 and the tuning tables). */
+	static constexpr bool isValidDataRate(uint8_t rate);
+	static constexpr bool isValidPulseFrequency(uint8_t freq);
+	static constexpr bool isValidChannel(uint8_t channel);
+	static constexpr bool isValidPacSize(uint8_t pac);
+	static constexpr bool isValidPreambleLength(uint8_t rate, uint8_t prealen);
+	static constexpr bool isValidPreambleCode(uint8_t channel, uint8_t freq, uint8_t preacode);
+	// PAC size recommended for a preamble length (see DW1000 user manual table 6)
+	static constexpr uint8_t getRecommendedPacSize(uint8_t prealen);
+
+	/**
+	Register values tuned for a profile. Evaluated at compile time when the profile is a constant, e.g.
+
+	    static constexpr DW1000TuneImage blinkImage = DW1000::computeTuneImage(PROFILE_LONGDATA_RANGE_LOWPOWER);
+	*/
+	static constexpr DW1000TuneImage computeTuneImage(const RadioProfile &profile, bool smartPower = false);
+
+	/**
+	Switch to a precomputed mode, e.g. between exchanges. Only writes the mode dependent registers,
+	without the tuning computations and the OTP access of `commitConfiguration()`. The device is put
+	into idle mode, the receiver has to be restarted afterwards.
+
+	A switch takes 22 SPI transfers of 100 bytes in total, against 32 transfers of 147 bytes for
+	`newConfiguration()`, `enableMode()` and `commitConfiguration()` (see test/ModeSwitchBenchmark.cpp).
+	*/
+	void switchMode(const DW1000TuneImage &image);
+
 	// use RX/TX specific and general default settings
 	void setDefaults();
 
@@ -409,6 +684,21 @@ private:
 	std::function<void()> _handleReceiveFailed;
 	std::function<void()> _handleReceiveTimeout;
 	std::function<void()> _handleReceiveTimestampAvailable;
+	std::function<void()> _handleInterruptPending;
+
+	bool _deferredInterrupts;
+	volatile bool _interruptPending;
+
+	// bring-up state machine
+	BringUpStep _bringUpStep;
+	uint32_t _bringUpDue;
+	uint32_t _bringUpStepStart;
+	uint32_t _bringUpTimes[(uint8_t)BringUpStep::FAILED + 1];
+	bool _bringUpOk;
+
+	// warm restart
+	uint8_t _restoredRegisters;
+	std::function<void(bool)> _handleReady;
 
 	/* register caches. */
 	uint8_t _syscfg[LEN_SYS_CFG];
@@ -418,9 +708,10 @@ private:
 	uint8_t _sysmask[LEN_SYS_MASK];
 	uint8_t _chanctrl[LEN_CHAN_CTRL];
 
-	/* device status monitoring */
-	uint8_t _vmeas3v3;
-	uint8_t _tmeas23C;
+	/* factory calibration, device status monitoring */
+	DW1000Calibration _calibration;
+	uint8_t _crystalTrim;
+	bool _crystalTrimmed;
 
 	/* PAN and short address. */
 	uint8_t _networkAndAddress[LEN_PANADR];
@@ -439,16 +730,30 @@ private:
 
 	/* internal helper to remember how to properly act. */
 	bool _permanentReceive;
+	// end of the bounded receive window, see setReceiveWindowEnd()
+	bool _receiveWindowBounded;
+	DW1000Time _receiveWindowEnd;
 	bool _frameCheck;
 
 	// whether RX or TX is active
 	uint8_t _deviceMode;
+	bool _sniffMode;
+
+	// double buffered receive, one slot of the queue is always left free
+	bool _doubleBuffered;
+	DW1000ReceivedFrame _rxQueue[RX_FRAME_QUEUE_SIZE];
+	volatile uint8_t _rxQueueHead;
+	volatile uint8_t _rxQueueTail;
+	DW1000ReceivedFrame _rxFrame;
+	bool _rxFrameValid;
+	uint32_t _receiveOverruns;
 
 	// whether debounce clock is active
 	bool _debounceClockEnabled;
 
 	/* Arduino interrupt handler */
 	void handleInterrupt();
+	void onInterrupt();
 
 	/* Allow MAC frame filtering . */
 	// TODO auto-acknowledge
@@ -462,15 +767,35 @@ private:
 	// Reserved is used for the Blink message
 	void setFrameFilterAllowReserved(bool val);
 
-	// note: not sure if going to be implemented for now
-	void setDoubleBuffering(bool val);
 	// TODO is implemented, but needs testing
 	void useExtendedFrameLength(bool val);
-	// TODO is implemented, but needs testing
-	void waitForResponse(bool val);
 
 	/* tuning according to mode. */
 	void tune();
+	void writeCrystalTrim();
+	RadioProfile getCurrentProfile();
+	void writeTuneImage(const DW1000TuneImage &image);
+
+	/* key configuration registers, checked by warmRestart(). */
+	struct ConfigRegister
+	{
+		uint8_t cmd;
+		uint16_t offset;
+		uint8_t *expected;
+		uint8_t length;
+		bool tuned;
+	};
+	static constexpr uint8_t configRegistersNumber = 10;
+	// the longest of them, sizes the read-back buffer
+	static constexpr uint8_t configRegisterMaxLength = 4;
+	void getConfigRegisters(ConfigRegister registers[], DW1000TuneImage &image, uint8_t antennaDelay[]);
+	static constexpr void writeImageBytes(uint8_t data[], uint32_t val, uint16_t n)
+	{
+		for (uint16_t i = 0; i < n; i++)
+		{
+			data[i] = (val >> (i * 8)) & 0xFF;
+		}
+	}
 
 	/* device status flags */
 	bool isReceiveTimestampAvailable();
@@ -500,18 +825,35 @@ private:
 	void readTransmitFrameControlRegister();
 	void writeTransmitFrameControlRegister();
 
+	// permanent receive: the frame wait timeout for the rest of the window, false if it is over
+	bool armReceiveWindow();
+
+	/* double buffered receive. */
+	void receiveDoubleBuffered();
+	void captureReceivedFrame();
+	void toggleReceiveBuffer();
+	void syncReceiveBufferPointers();
+	void readReceiveBytes(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n);
+
 	/* clock management. */
 	void enableClock(uint8_t clock);
 
+	/* bring-up, returns the time [ms] to wait before the next step. */
+	uint32_t runBringUpStep(BringUpStep step);
+
+	/* OTP calibration, read in one batch. */
+	void loadCalibration();
+
 	/* LDE micro-code management. */
-	void manageLDE();
+	void startLDELoad();
+	void finishLDELoad();
 
 	/* timestamp correction. */
 	void correctTimestamp(DW1000Time &timestamp);
 
 	/* reading and writing bytes from and to DW1000 module. */
 	void readBytes(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n);
-	void readBytesOTP(uint16_t address, uint8_t data[]);
+	void readBytesOTP(const uint16_t addresses[], uint8_t data[][LEN_OTP_RDAT], uint8_t n);
 	void writeByte(uint8_t cmd, uint16_t offset, uint8_t data);
 	void writeBytes(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n);
 
@@ -547,3 +889,331 @@ private:
 	static constexpr uint8_t BIAS_900_16[] = {137, 122, 105, 88, 69, 47, 25, 0, 21, 48, 79, 105, 127, 147, 160, 169, 178, 197};
 	static constexpr uint8_t BIAS_900_64[] = {147, 133, 117, 99, 75, 50, 29, 0, 24, 45, 63, 76, 87, 98, 116, 122, 132, 142};
 };
+
+constexpr bool DW1000::isValidDataRate(uint8_t rate)
+{
+	return rate == TRX_RATE_110KBPS || rate == TRX_RATE_850KBPS || rate == TRX_RATE_6800KBPS;
+}
+
+constexpr bool DW1000::isValidPulseFrequency(uint8_t freq)
+{
+	return freq == TX_PULSE_FREQ_16MHZ || freq == TX_PULSE_FREQ_64MHZ;
+}
+
+constexpr bool DW1000::isValidChannel(uint8_t channel)
+{
+	return (channel >= CHANNEL_1 && channel <= CHANNEL_5) || channel == CHANNEL_7;
+}
+
+constexpr bool DW1000::isValidPacSize(uint8_t pac)
+{
+	return pac == PAC_SIZE_8 || pac == PAC_SIZE_16 || pac == PAC_SIZE_32 || pac == PAC_SIZE_64;
+}
+
+constexpr bool DW1000::isValidPreambleLength(uint8_t rate, uint8_t prealen)
+{
+	switch (prealen)
+	{
+	case TX_PREAMBLE_LEN_64:
+		return rate == TRX_RATE_6800KBPS;
+	case TX_PREAMBLE_LEN_128:
+	case TX_PREAMBLE_LEN_256:
+	case TX_PREAMBLE_LEN_512:
+	case TX_PREAMBLE_LEN_1024:
+		return rate == TRX_RATE_850KBPS || rate == TRX_RATE_6800KBPS;
+	case TX_PREAMBLE_LEN_1536:
+	case TX_PREAMBLE_LEN_2048:
+	case TX_PREAMBLE_LEN_4096:
+		return rate == TRX_RATE_110KBPS;
+	default:
+		return false;
+	}
+}
+
+constexpr bool DW1000::isValidPreambleCode(uint8_t channel, uint8_t freq, uint8_t preacode)
+{
+	if (freq == TX_PULSE_FREQ_64MHZ)
+	{
+		// shared by all channels of a bandwidth
+		if (channel == CHANNEL_4 || channel == CHANNEL_7)
+		{
+			return preacode >= PREAMBLE_CODE_64MHZ_17 && preacode <= PREAMBLE_CODE_64MHZ_20;
+		}
+		return preacode >= PREAMBLE_CODE_64MHZ_9 && preacode <= PREAMBLE_CODE_64MHZ_12;
+	}
+	switch (channel)
+	{
+	case CHANNEL_1:
+		return preacode == PREAMBLE_CODE_16MHZ_1 || preacode == PREAMBLE_CODE_16MHZ_2;
+	case CHANNEL_2:
+	case CHANNEL_5:
+		return preacode == PREAMBLE_CODE_16MHZ_3 || preacode == PREAMBLE_CODE_16MHZ_4;
+	case CHANNEL_3:
+		return preacode == PREAMBLE_CODE_16MHZ_5 || preacode == PREAMBLE_CODE_16MHZ_6;
+	case CHANNEL_4:
+	case CHANNEL_7:
+		return preacode == PREAMBLE_CODE_16MHZ_7 || preacode == PREAMBLE_CODE_16MHZ_8;
+	default:
+		return false;
+	}
+}
+
+constexpr uint8_t DW1000::getRecommendedPacSize(uint8_t prealen)
+{
+	switch (prealen)
+	{
+	case TX_PREAMBLE_LEN_64:
+	case TX_PREAMBLE_LEN_128:
+		return PAC_SIZE_8;
+	case TX_PREAMBLE_LEN_256:
+	case TX_PREAMBLE_LEN_512:
+		return PAC_SIZE_16;
+	case TX_PREAMBLE_LEN_1024:
+		return PAC_SIZE_32;
+	default:
+		return PAC_SIZE_64;
+	}
+}
+
+constexpr DW1000TuneImage DW1000::computeTuneImage(const RadioProfile &profile, bool smartPower)
+{
+	// the register bytes start zeroed
+	DW1000TuneImage image = {profile, smartPower, {}};
+	const uint8_t dataRate = profile.getDataRate();
+	const uint8_t prf = profile.getPulseFrequency();
+	const uint8_t prealen = profile.getPreambleLength();
+	const uint8_t pac = profile.getPacSize();
+	const uint8_t channel = profile.getChannel();
+	const uint8_t preambleCode = profile.getPreambleCode();
+	const bool prf16 = prf == TX_PULSE_FREQ_16MHZ;
+	const bool prf64 = prf == TX_PULSE_FREQ_64MHZ;
+	// AGC_TUNE1
+	if (prf16 || prf64)
+	{
+		writeImageBytes(image.agcTune1, prf16 ? 0x8870 : 0x889B, LEN_AGC_TUNE1);
+	}
+	// AGC_TUNE2
+	writeImageBytes(image.agcTune2, 0x2502A907L, LEN_AGC_TUNE2);
+	// AGC_TUNE3
+	writeImageBytes(image.agcTune3, 0x0035, LEN_AGC_TUNE3);
+	// DRX_TUNE0b (already optimized according to Table 20 of user manual)
+	if (dataRate == TRX_RATE_110KBPS)
+	{
+		writeImageBytes(image.drxTune0b, 0x0016, LEN_DRX_TUNE0b);
+	}
+	else if (dataRate == TRX_RATE_850KBPS)
+	{
+		writeImageBytes(image.drxTune0b, 0x0006, LEN_DRX_TUNE0b);
+	}
+	else if (dataRate == TRX_RATE_6800KBPS)
+	{
+		writeImageBytes(image.drxTune0b, 0x0001, LEN_DRX_TUNE0b);
+	}
+	// DRX_TUNE1a
+	if (prf16 || prf64)
+	{
+		writeImageBytes(image.drxTune1a, prf16 ? 0x0087 : 0x008D, LEN_DRX_TUNE1a);
+	}
+	// DRX_TUNE1b
+	if (prealen == TX_PREAMBLE_LEN_1536 || prealen == TX_PREAMBLE_LEN_2048 || prealen == TX_PREAMBLE_LEN_4096)
+	{
+		if (dataRate == TRX_RATE_110KBPS)
+		{
+			writeImageBytes(image.drxTune1b, 0x0064, LEN_DRX_TUNE1b);
+		}
+	}
+	else if (prealen != TX_PREAMBLE_LEN_64)
+	{
+		if (dataRate == TRX_RATE_850KBPS || dataRate == TRX_RATE_6800KBPS)
+		{
+			writeImageBytes(image.drxTune1b, 0x0020, LEN_DRX_TUNE1b);
+		}
+	}
+	else if (dataRate == TRX_RATE_6800KBPS)
+	{
+		writeImageBytes(image.drxTune1b, 0x0010, LEN_DRX_TUNE1b);
+	}
+	// DRX_TUNE2
+	if (prf16 || prf64)
+	{
+		if (pac == PAC_SIZE_8)
+		{
+			writeImageBytes(image.drxTune2, prf16 ? 0x311A002DL : 0x313B006BL, LEN_DRX_TUNE2);
+		}
+		else if (pac == PAC_SIZE_16)
+		{
+			writeImageBytes(image.drxTune2, prf16 ? 0x331A0052L : 0x333B00BEL, LEN_DRX_TUNE2);
+		}
+		else if (pac == PAC_SIZE_32)
+		{
+			writeImageBytes(image.drxTune2, prf16 ? 0x351A009AL : 0x353B015EL, LEN_DRX_TUNE2);
+		}
+		else if (pac == PAC_SIZE_64)
+		{
+			writeImageBytes(image.drxTune2, prf16 ? 0x371A011DL : 0x373B0296L, LEN_DRX_TUNE2);
+		}
+	}
+	// DRX_TUNE4H
+	writeImageBytes(image.drxTune4H, prealen == TX_PREAMBLE_LEN_64 ? 0x0010 : 0x0028, LEN_DRX_TUNE4H);
+	// RF_RXCTRLH
+	writeImageBytes(image.rfRxCtrlH, (channel != CHANNEL_4 && channel != CHANNEL_7) ? 0xD8 : 0xBC, LEN_RF_RXCTRLH);
+	// RF_TXCTRL, TC_PGDELAY, FS_PLLCFG and FS_PLLTUNE
+	switch (channel)
+	{
+	case CHANNEL_1:
+		writeImageBytes(image.rfTxCtrl, 0x00005C40L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0xC9, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x09000407L, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0x1E, LEN_FS_PLLTUNE);
+		break;
+	case CHANNEL_2:
+		writeImageBytes(image.rfTxCtrl, 0x00045CA0L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0xC2, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x08400508L, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0x26, LEN_FS_PLLTUNE);
+		break;
+	case CHANNEL_3:
+		writeImageBytes(image.rfTxCtrl, 0x00086CC0L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0xC5, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x08401009L, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0x56, LEN_FS_PLLTUNE);
+		break;
+	case CHANNEL_4:
+		writeImageBytes(image.rfTxCtrl, 0x00045C80L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0x95, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x08400508L, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0x26, LEN_FS_PLLTUNE);
+		break;
+	case CHANNEL_5:
+		writeImageBytes(image.rfTxCtrl, 0x001E3FE0L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0xC0, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x0800041DL, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0xBE, LEN_FS_PLLTUNE);
+		break;
+	case CHANNEL_7:
+		writeImageBytes(image.rfTxCtrl, 0x001E7DE0L, LEN_RF_TXCTRL);
+		writeImageBytes(image.tcPgDelay, 0x93, LEN_TC_PGDELAY);
+		writeImageBytes(image.fsPllCfg, 0x0800041DL, LEN_FS_PLLCFG);
+		writeImageBytes(image.fsPllTune, 0xBE, LEN_FS_PLLTUNE);
+		break;
+	default:
+		break;
+	}
+	// LDE_CFG1
+	writeImageBytes(image.ldeCfg1, 0xD, LEN_LDE_CFG1);
+	// LDE_CFG2
+	if (prf16 || prf64)
+	{
+		writeImageBytes(image.ldeCfg2, prf16 ? 0x1607 : 0x0607, LEN_LDE_CFG2);
+	}
+	// LDE_REPC (divided by 8 for 110 kb/s)
+	uint16_t repc = 0;
+	switch (preambleCode)
+	{
+	case PREAMBLE_CODE_16MHZ_1:
+	case PREAMBLE_CODE_16MHZ_2:
+		repc = 0x5998;
+		break;
+	case PREAMBLE_CODE_16MHZ_3:
+	case PREAMBLE_CODE_16MHZ_8:
+		repc = 0x51EA;
+		break;
+	case PREAMBLE_CODE_16MHZ_4:
+		repc = 0x428E;
+		break;
+	case PREAMBLE_CODE_16MHZ_5:
+		repc = 0x451E;
+		break;
+	case PREAMBLE_CODE_16MHZ_6:
+		repc = 0x2E14;
+		break;
+	case PREAMBLE_CODE_16MHZ_7:
+		repc = 0x8000;
+		break;
+	case PREAMBLE_CODE_64MHZ_9:
+		repc = 0x28F4;
+		break;
+	case PREAMBLE_CODE_64MHZ_10:
+	case PREAMBLE_CODE_64MHZ_17:
+		repc = 0x3332;
+		break;
+	case PREAMBLE_CODE_64MHZ_11:
+		repc = 0x3AE0;
+		break;
+	case PREAMBLE_CODE_64MHZ_12:
+		repc = 0x3D70;
+		break;
+	case PREAMBLE_CODE_64MHZ_18:
+	case PREAMBLE_CODE_64MHZ_19:
+		repc = 0x35C2;
+		break;
+	case PREAMBLE_CODE_64MHZ_20:
+		repc = 0x47AE;
+		break;
+	default:
+		break;
+	}
+	writeImageBytes(image.ldeRepc, dataRate == TRX_RATE_110KBPS ? (repc >> 3) : repc, LEN_LDE_REPC);
+	// TX_POWER (smart transmit power control or the same power for all parts of the frame)
+	uint32_t smart = 0;
+	uint32_t manual = 0;
+	switch (channel)
+	{
+	case CHANNEL_1:
+	case CHANNEL_2:
+		smart = prf16 ? 0x15355575L : 0x07274767L;
+		manual = prf16 ? 0x75757575L : 0x67676767L;
+		break;
+	case CHANNEL_3:
+		smart = prf16 ? 0x0F2F4F6FL : 0x2B4B6B8BL;
+		manual = prf16 ? 0x6F6F6F6FL : 0x8B8B8B8BL;
+		break;
+	case CHANNEL_4:
+		smart = prf16 ? 0x1F1F3F5FL : 0x3A5A7A9AL;
+		manual = prf16 ? 0x5F5F5F5FL : 0x9A9A9A9AL;
+		break;
+	case CHANNEL_5:
+		smart = prf16 ? 0x0E082848L : 0x25456585L;
+		manual = prf16 ? 0x48484848L : 0x85858585L;
+		break;
+	case CHANNEL_7:
+		smart = prf16 ? 0x32527292L : 0x5171B1D1L;
+		manual = prf16 ? 0x92929292L : 0xD1D1D1D1L;
+		break;
+	default:
+		break;
+	}
+	if (prf16 || prf64)
+	{
+		writeImageBytes(image.txPower, smartPower ? smart : manual, LEN_TX_POWER);
+	}
+	return image;
+}
+
+/**
+Build a radio profile, invalid combinations do not compile. The PAC size and the SFD default to the
+recommended ones (the Decawave SFD below 6.8 Mb/s), e.g.
+
+    constexpr RadioProfile fast = makeRadioProfile<DW1000::TRX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_64MHZ,
+        DW1000::TX_PREAMBLE_LEN_128, DW1000::CHANNEL_2, DW1000::PREAMBLE_CODE_64MHZ_9>();
+*/
+template <uint8_t dataRate, uint8_t pulseFrequency, uint8_t preambleLength, uint8_t channel, uint8_t preambleCode,
+		  uint8_t pacSize = DW1000::getRecommendedPacSize(preambleLength), bool nonStandardSfd = (dataRate != DW1000::TRX_RATE_6800KBPS)>
+constexpr RadioProfile makeRadioProfile()
+{
+	static_assert(DW1000::isValidDataRate(dataRate), "unknown data rate");
+	static_assert(DW1000::isValidPulseFrequency(pulseFrequency), "unknown pulse repetition frequency");
+	static_assert(DW1000::isValidChannel(channel), "unknown channel");
+	static_assert(DW1000::isValidPacSize(pacSize), "unknown PAC size");
+	static_assert(DW1000::isValidPreambleLength(dataRate, preambleLength), "preamble length not supported at this data rate");
+	static_assert(DW1000::isValidPreambleCode(channel, pulseFrequency, preambleCode), "preamble code not allowed on this channel and PRF");
+	return RadioProfile(dataRate, pulseFrequency, preambleLength, preambleCode, pacSize, channel, nonStandardSfd);
+}
+
+// the pre-defined modes (see DW1000::enableMode()) on the default channel 5
+constexpr RadioProfile PROFILE_LONGDATA_RANGE_LOWPOWER = makeRadioProfile<DW1000::TRX_RATE_110KBPS, DW1000::TX_PULSE_FREQ_16MHZ, DW1000::TX_PREAMBLE_LEN_2048, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_16MHZ_4>();
+constexpr RadioProfile PROFILE_SHORTDATA_FAST_LOWPOWER = makeRadioProfile<DW1000::TRX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ, DW1000::TX_PREAMBLE_LEN_128, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_16MHZ_4>();
+constexpr RadioProfile PROFILE_LONGDATA_FAST_LOWPOWER = makeRadioProfile<DW1000::TRX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ, DW1000::TX_PREAMBLE_LEN_1024, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_16MHZ_4>();
+constexpr RadioProfile PROFILE_SHORTDATA_FAST_ACCURACY = makeRadioProfile<DW1000::TRX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_64MHZ, DW1000::TX_PREAMBLE_LEN_128, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_64MHZ_10>();
+constexpr RadioProfile PROFILE_LONGDATA_FAST_ACCURACY = makeRadioProfile<DW1000::TRX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_64MHZ, DW1000::TX_PREAMBLE_LEN_1024, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_64MHZ_10>();
+constexpr RadioProfile PROFILE_LONGDATA_RANGE_ACCURACY = makeRadioProfile<DW1000::TRX_RATE_110KBPS, DW1000::TX_PULSE_FREQ_64MHZ, DW1000::TX_PREAMBLE_LEN_2048, DW1000::CHANNEL_5, DW1000::PREAMBLE_CODE_64MHZ_10>();
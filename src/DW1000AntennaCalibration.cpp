@@ -0,0 +1,224 @@
+#include <math.h>
+#include "DW1000AntennaCalibration.h"
+#include "DW1000Time.h"
+
+DW1000AntennaCalibration::DW1000AntennaCalibration()
+{
+	reset();
+}
+
+void DW1000AntennaCalibration::reset()
+{
+	_nodesNumber = 0;
+	_residual = 0;
+	for (uint8_t i = 0; i < MAX_CALIBRATION_NODES; i++)
+	{
+		_corrections[i] = {0, 0, 0};
+		for (uint8_t j = 0; j < MAX_CALIBRATION_NODES; j++)
+		{
+			_distances[i][j] = -1;
+			_rangeSums[i][j] = 0;
+			_rangeCounts[i][j] = 0;
+		}
+	}
+}
+
+void DW1000AntennaCalibration::clearRanges()
+{
+	_residual = 0;
+	for (uint8_t i = 0; i < MAX_CALIBRATION_NODES; i++)
+	{
+		_corrections[i].delayCorrection = 0;
+		_corrections[i].samples = 0;
+		for (uint8_t j = 0; j < MAX_CALIBRATION_NODES; j++)
+		{
+			_rangeSums[i][j] = 0;
+			_rangeCounts[i][j] = 0;
+		}
+	}
+}
+
+int8_t DW1000AntennaCalibration::searchNode(uint16_t shortAddress)
+{
+	for (uint8_t i = 0; i < _nodesNumber; i++)
+	{
+		if (_corrections[i].shortAddress == shortAddress)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int8_t DW1000AntennaCalibration::addNode(uint16_t shortAddress)
+{
+	int8_t index = searchNode(shortAddress);
+	if (index >= 0 || _nodesNumber >= MAX_CALIBRATION_NODES)
+	{
+		return index;
+	}
+	_corrections[_nodesNumber] = {shortAddress, 0, 0};
+	return _nodesNumber++;
+}
+
+bool DW1000AntennaCalibration::setDistance(uint16_t addressA, uint16_t addressB, float meters)
+{
+	int8_t a = addNode(addressA);
+	int8_t b = addNode(addressB);
+	if (a < 0 || b < 0 || a == b)
+	{
+		return false;
+	}
+	if (a > b)
+	{
+		int8_t swap = a;
+		a = b;
+		b = swap;
+	}
+	_distances[a][b] = meters;
+	return true;
+}
+
+void DW1000AntennaCalibration::addRange(uint16_t addressA, uint16_t addressB, float meters)
+{
+	int8_t a = searchNode(addressA);
+	int8_t b = searchNode(addressB);
+	if (a < 0 || b < 0 || a == b)
+	{
+		return;
+	}
+	if (a > b)
+	{
+		int8_t swap = a;
+		a = b;
+		b = swap;
+	}
+	if (_distances[a][b] < 0 || _rangeCounts[a][b] == UINT16_MAX)
+	{
+		return;
+	}
+	_rangeSums[a][b] += meters;
+	_rangeCounts[a][b]++;
+}
+
+bool DW1000AntennaCalibration::hasSamples(uint16_t samples)
+{
+	for (uint8_t a = 0; a < _nodesNumber; a++)
+	{
+		for (uint8_t b = a + 1; b < _nodesNumber; b++)
+		{
+			if (_distances[a][b] >= 0 && _rangeCounts[a][b] < samples)
+			{
+				return false;
+			}
+		}
+	}
+	return _nodesNumber >= 3;
+}
+
+bool DW1000AntennaCalibration::solve()
+{
+	uint8_t n = _nodesNumber;
+	if (n < 3)
+	{
+		return false;
+	}
+	// normal equations of r_ab - d_ab = e_a + e_b, one equation per pair (the mean of its ranges)
+	float m[MAX_CALIBRATION_NODES][MAX_CALIBRATION_NODES + 1] = {};
+	for (uint8_t a = 0; a < n; a++)
+	{
+		_corrections[a].samples = 0;
+	}
+	for (uint8_t a = 0; a < n; a++)
+	{
+		for (uint8_t b = a + 1; b < n; b++)
+		{
+			if (_rangeCounts[a][b] == 0)
+			{
+				continue;
+			}
+			float error = _rangeSums[a][b] / _rangeCounts[a][b] - _distances[a][b];
+			m[a][a] += 1;
+			m[b][b] += 1;
+			m[a][b] += 1;
+			m[b][a] += 1;
+			m[a][n] += error;
+			m[b][n] += error;
+			_corrections[a].samples += _rangeCounts[a][b];
+			_corrections[b].samples += _rangeCounts[a][b];
+		}
+	}
+
+	// Gauss-Jordan elimination with partial pivoting
+	for (uint8_t col = 0; col < n; col++)
+	{
+		uint8_t pivot = col;
+		for (uint8_t row = col + 1; row < n; row++)
+		{
+			if (fabsf(m[row][col]) > fabsf(m[pivot][col]))
+			{
+				pivot = row;
+			}
+		}
+		// a node without ranges, or pairs that do not close an odd loop
+		if (fabsf(m[pivot][col]) < 1e-3f)
+		{
+			return false;
+		}
+		for (uint8_t k = 0; k <= n; k++)
+		{
+			float swap = m[col][k];
+			m[col][k] = m[pivot][k];
+			m[pivot][k] = swap;
+		}
+		for (uint8_t row = 0; row < n; row++)
+		{
+			if (row == col)
+			{
+				continue;
+			}
+			float factor = m[row][col] / m[col][col];
+			for (uint8_t k = col; k <= n; k++)
+			{
+				m[row][k] -= factor * m[col][k];
+			}
+		}
+	}
+
+	float errors[MAX_CALIBRATION_NODES];
+	for (uint8_t a = 0; a < n; a++)
+	{
+		errors[a] = m[a][n] / m[a][a];
+		// a longer delay shortens the measured ranges
+		_corrections[a].delayCorrection = (int16_t)lroundf(errors[a] * DW1000Time::DISTANCE_OF_RADIO_INV);
+	}
+
+	float squares = 0;
+	uint8_t pairs = 0;
+	for (uint8_t a = 0; a < n; a++)
+	{
+		for (uint8_t b = a + 1; b < n; b++)
+		{
+			if (_rangeCounts[a][b] == 0)
+			{
+				continue;
+			}
+			float error = _rangeSums[a][b] / _rangeCounts[a][b] - _distances[a][b] - errors[a] - errors[b];
+			squares += error * error;
+			pairs++;
+		}
+	}
+	_residual = sqrtf(squares / pairs);
+	return true;
+}
+
+bool DW1000AntennaCalibration::getCorrection(uint16_t shortAddress, int16_t &delayCorrection)
+{
+	int8_t index = searchNode(shortAddress);
+	if (index < 0)
+	{
+		return false;
+	}
+	delayCorrection = _corrections[index].delayCorrection;
+	return true;
+}
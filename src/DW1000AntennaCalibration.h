@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+// nodes (short addresses) taking part in one antenna delay calibration
+#define MAX_CALIBRATION_NODES 8
+
+// calibration result of one node
+struct AntennaDelayCorrection
+{
+	uint16_t shortAddress;
+	// to be added to the antenna delay the node used during the calibration, in DW1000 time units
+	int16_t delayCorrection;
+	// ranges that were involved
+	uint16_t samples;
+};
+
+/**
+Antenna delay calibration from ranges measured between nodes at known distances.
+
+Every node uses its antenna delay for both transmit and receive, so the range measured between
+node i and j is off by the sum of their delay errors: r_ij = d_ij + e_i + e_j. The errors are
+solved by least squares over all pairs with a known distance, which needs at least three nodes
+and a pair set that closes an odd loop (e.g. a triangle), otherwise e_i + e_j cannot be split.
+
+The ranges may come from any node of the network, the corrections apply to the delays the nodes
+were running with while they were measured.
+*/
+class DW1000AntennaCalibration
+{
+public:
+	DW1000AntennaCalibration();
+
+	// forget all nodes, distances and ranges
+	void reset();
+	// forget the ranges and the last solution, keep the nodes and their known distances
+	void clearRanges();
+
+	// known distance in m between two nodes, returns false if the node table is full
+	bool setDistance(uint16_t addressA, uint16_t addressB, float meters);
+	// measured range in m, ignored if the distance of the pair is unknown
+	void addRange(uint16_t addressA, uint16_t addressB, float meters);
+
+	// every pair with a known distance has at least `samples` ranges
+	bool hasSamples(uint16_t samples);
+
+	// least squares solution, returns false if the pairs do not determine every node
+	bool solve();
+	// valid after a successful solve()
+	uint8_t getNodesNumber() { return _nodesNumber; }
+	const AntennaDelayCorrection &getCorrection(uint8_t index) { return _corrections[index]; }
+	bool getCorrection(uint16_t shortAddress, int16_t &delayCorrection);
+	// root mean square of the pair range errors left after the correction, in m
+	float getResidual() { return _residual; }
+
+private:
+	uint8_t _nodesNumber;
+	AntennaDelayCorrection _corrections[MAX_CALIBRATION_NODES];
+	float _residual;
+	// per pair (lower index first): known distance (negative: unknown), sum and number of ranges
+	float _distances[MAX_CALIBRATION_NODES][MAX_CALIBRATION_NODES];
+	float _rangeSums[MAX_CALIBRATION_NODES][MAX_CALIBRATION_NODES];
+	uint16_t _rangeCounts[MAX_CALIBRATION_NODES][MAX_CALIBRATION_NODES];
+
+	int8_t searchNode(uint16_t shortAddress);
+	int8_t addNode(uint16_t shortAddress);
+};
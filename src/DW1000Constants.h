@@ -39,6 +39,7 @@
 #define DIS_DRXB_BIT 12
 #define DIS_STXP_BIT 18
 #define HIRQ_POL_BIT 9
+#define RXWTOE_BIT 28
 #define RXAUTR_BIT 29
 #define PHR_MODE_SUB 16
 #define LEN_PHR_MODE_SUB 2
@@ -54,6 +55,7 @@
 #define WAIT4RESP_BIT 7
 #define RXENAB_BIT 8
 #define RXDLYS_BIT 9
+#define HRBPT_BIT 24
 
 // system event status register
 #define SYS_STATUS 0x0F
@@ -71,11 +73,14 @@
 #define RXFCE_BIT 15
 #define RXRFSL_BIT 16
 #define RXRFTO_BIT 17
+#define RXOVRR_BIT 20
 #define RXPTO_BIT 21
 #define RXSFDTO_BIT 26
 #define LDEERR_BIT 18
 #define RFPLL_LL_BIT 24
 #define CLKPLL_LL_BIT 25
+#define HSRBP_BIT 30
+#define ICRBP_BIT 31
 
 // system event mask register
 // NOTE: uses the bit definitions of SYS_STATUS (below 32)
@@ -90,8 +95,10 @@
 #define RX_TIME 0x15
 #define LEN_RX_TIME 14
 #define RX_STAMP_SUB 0x00
+#define FP_INDEX_SUB 0x05
 #define FP_AMPL1_SUB 0x07
 #define LEN_RX_STAMP LEN_STAMP
+#define LEN_FP_INDEX 2
 #define LEN_FP_AMPL1 2
 
 // RX frame quality
@@ -106,6 +113,15 @@
 #define LEN_FP_AMPL3 2
 #define LEN_CIR_PWR 2
 
+// accumulator (channel impulse response), complex samples of 16 bit real and imaginary parts
+#define ACC_MEM 0x25
+#define LEN_ACC_MEM 4064
+#define LEN_ACC_SAMPLE 4
+#define ACC_SAMPLES_16MHZ 992
+#define ACC_SAMPLES_64MHZ 1016
+#define FACE_BIT 6
+#define AMCE_BIT 15
+
 // TX timestamp register
 #define TX_TIME 0x17
 #define LEN_TX_TIME 10
@@ -116,6 +132,14 @@
 #define DX_TIME 0x0A
 #define LEN_DX_TIME LEN_STAMP
 
+// acknowledgement and response time (W4R_TIM in units of 512/499.2 MHz, ~1.026 us)
+#define ACK_RESP_T 0x1A
+#define LEN_ACK_RESP_T 4
+
+// receive frame wait timeout (in units of 512/499.2 MHz, ~1.026 us)
+#define RX_FWTO 0x0C
+#define LEN_RX_FWTO 2
+
 // transmit data buffer
 #define TX_BUFFER 0x09
 #define LEN_TX_BUFFER 1024
@@ -156,6 +180,14 @@
 #define LEN_OTP_CTRL 2
 #define LEN_OTP_RDAT 4
 
+// OTP memory map, factory calibration words (see 6.3.1)
+#define OTP_EUI_ADDR 0x000
+#define OTP_LDOTUNE_ADDR 0x004
+#define OTP_VMEAS_ADDR 0x008
+#define OTP_TMEAS_ADDR 0x009
+#define OTP_ANTD_ADDR 0x01C
+#define OTP_XTALT_ADDR 0x01E
+
 // AGC_TUNE1/2 (for re-tuning only)
 #define AGC_TUNE 0x23
 #define AGC_TUNE1_SUB 0x04
@@ -178,6 +210,14 @@
 #define LEN_DRX_TUNE2 4
 #define LEN_DRX_TUNE4H 2
 
+// DRX_PRETOC (preamble detection timeout, in PACs)
+#define DRX_PRETOC_SUB 0x24
+#define LEN_DRX_PRETOC 2
+
+// DRX_CAR_INT (carrier recovery integrator, read only)
+#define DRX_CAR_INT_SUB 0x28
+#define LEN_DRX_CAR_INT 3
+
 // LDE_CFG1 (for re-tuning only)
 #define LDE_IF 0x2E
 #define LDE_CFG1_SUB 0x0806
@@ -193,6 +233,10 @@
 #define TX_POWER 0x1E
 #define LEN_TX_POWER 4
 
+// RX_SNIFF (preamble sniff mode)
+#define RX_SNIFF 0x1D
+#define LEN_RX_SNIFF 4
+
 // RF_CONF (for re-tuning only)
 #define RF_CONF 0x28
 #define RF_RXCTRLH_SUB 0x0B
@@ -221,6 +265,8 @@
 #define AON_WCFG_SUB 0x00
 #define LEN_AON_WCFG 2
 #define ONW_LDC_BIT 6
+#define PRES_SLEEP_BIT 8
+#define ONW_LLDE_BIT 11
 #define ONW_LDD0_BIT 12
 #define AON_CTRL_SUB 0x02
 #define LEN_AON_CTRL 1
@@ -243,8 +289,10 @@
 #define LEN_PMSC_CTRL0 4
 #define LEN_PMSC_CTRL1 4
 #define LEN_PMSC_LEDC 4
+#define RXCLKS_BIT 2
 #define GPDCE_BIT 18
 #define KHZCLKEN_BIT 23
+#define PLL2_SEQ_EN_BIT 24
 #define BLNKEN 8
 
 #define ATXSLP_BIT 11
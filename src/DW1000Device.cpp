@@ -4,12 +4,18 @@
 // Constructor and destructor
 DW1000Device::DW1000Device(PortableCode &portable) : _portable(portable)
 {
+	resetClockOffset();
+	setRangeScore(0, false);
+	_rangeRate = 0;
 	noteActivity();
 }
 DW1000Device::DW1000Device(PortableCode &portable, uint8_t shortAddress[]) : _portable(portable)
 {
 	// we set the 2 bytes address
 	setShortAddress(shortAddress);
+	resetClockOffset();
+	setRangeScore(0, false);
+	_rangeRate = 0;
 	noteActivity();
 }
 
@@ -41,3 +47,21 @@ bool DW1000Device::isInactive()
 	// One second of inactivity
 	return _portable.millis() - _activity > INACTIVITY_TIME;
 }
+
+void DW1000Device::updateClockOffset(float offsetPpm)
+{
+	if (!_clockOffsetValid)
+	{
+		// first sample, nothing to smooth yet
+		_clockOffset = offsetPpm;
+		_clockOffsetValid = true;
+		return;
+	}
+	_clockOffset += CLOCK_OFFSET_SMOOTHING * (offsetPpm - _clockOffset);
+}
+
+void DW1000Device::resetClockOffset()
+{
+	_clockOffset = 0;
+	_clockOffsetValid = false;
+}
@@ -2,6 +2,9 @@
 
 #define INACTIVITY_TIME 2000
 
+// weight of a new sample in the smoothed clock offset (exponential moving average)
+#define CLOCK_OFFSET_SMOOTHING 0.25f
+
 #include "DW1000Time.h"
 #include "portable.h"
 
@@ -20,10 +23,16 @@ public:
 	void setPayload(float payload) { _payload = payload; }
 	void setIndex(uint8_t index) { _index = index; }
 	void setRange(float range) { _range = range; }
+	void setRangeRate(float rate) { _rangeRate = rate; }
 	void setRXPower(float power) { _RXPower = power; }
 	void setFPPower(float power) { _FPPower = power; }
 	void setQuality(float quality) { _quality = quality; }
 	void setReplyTime(uint16_t replyDelayTimeUs) { _replyDelayTimeUs = replyDelayTimeUs; }
+	void setRangeScore(float score, bool nlos)
+	{
+		_rangeScore = score;
+		_nlos = nlos;
+	}
 
 	// Getters
 	uint8_t getIndex() { return _index; }
@@ -32,10 +41,20 @@ public:
 	uint16_t getReplyTime() { return _replyDelayTimeUs; }
 
 	float getRange() { return _range; }
+	// change of the filtered range in m/s, 0 without the Kalman stage of the range filter
+	float getRangeRate() { return _rangeRate; }
 	float getPayload() { return _payload; }
 	float getRXPower() { return _RXPower; }
 	float getFPPower() { return _FPPower; }
 	float getQuality() { return _quality; }
+	float getClockOffset() { return _clockOffset; }
+	// quality of the last range, 0 (unusable) to 1 (clean line of sight), and the NLOS verdict
+	float getRangeScore() { return _rangeScore; }
+	bool isNLOS() { return _nlos; }
+
+	// clock offset of the device relative to ours, in ppm
+	void updateClockOffset(float offsetPpm);
+	void resetClockOffset();
 
 	bool isAddressEqual(DW1000Device *device);
 	bool isShortAddressEqual(DW1000Device *device);
@@ -57,6 +76,8 @@ public:
 
 	void noteActivity();
 	bool isInactive();
+	bool isInactive(uint32_t now) { return now - _activity > INACTIVITY_TIME; }
+	unsigned long getLastActivity() { return _activity; }
 	void setExpectedMessageID(uint8_t id) { _expectedMessageID = id; }
 	uint8_t getExpectedMessageID() { return _expectedMessageID; }
 
@@ -68,9 +89,14 @@ private:
 	uint8_t _index;
 
 	float _range;
+	float _rangeRate;
 	float _RXPower;
 	float _FPPower;
 	float _quality;
 	float _payload;
+	float _clockOffset;
+	float _rangeScore;
+	bool _nlos;
+	bool _clockOffsetValid;
 	uint8_t _expectedMessageID;
 };
@@ -0,0 +1,315 @@
+#include <math.h>
+#include "DW1000Position.h"
+
+DW1000Position::DW1000Position()
+{
+	_anchorsNumber = 0;
+	_dimensions = 3;
+	_height = 0;
+	_lastFix = {false, 0, 0, 0, 0, 0, 0, 0};
+}
+
+int8_t DW1000Position::searchAnchor(uint16_t shortAddress)
+{
+	for (uint8_t i = 0; i < _anchorsNumber; i++)
+	{
+		if (_anchorAddresses[i] == shortAddress)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool DW1000Position::setAnchor(uint16_t shortAddress, float x, float y, float z)
+{
+	int8_t index = searchAnchor(shortAddress);
+	if (index < 0)
+	{
+		if (_anchorsNumber >= MAX_POSITION_ANCHORS)
+		{
+			return false;
+		}
+		index = _anchorsNumber++;
+		_anchorAddresses[index] = shortAddress;
+	}
+	_anchors[index][0] = x;
+	_anchors[index][1] = y;
+	_anchors[index][2] = z;
+	return true;
+}
+
+void DW1000Position::removeAnchor(uint16_t shortAddress)
+{
+	int8_t index = searchAnchor(shortAddress);
+	if (index < 0)
+	{
+		return;
+	}
+	// the last one takes its place
+	_anchorsNumber--;
+	_anchorAddresses[index] = _anchorAddresses[_anchorsNumber];
+	for (uint8_t k = 0; k < 3; k++)
+	{
+		_anchors[index][k] = _anchors[_anchorsNumber][k];
+	}
+}
+
+void DW1000Position::setDimensions(uint8_t dimensions, float height)
+{
+	_dimensions = dimensions == 2 ? 2 : 3;
+	_height = height;
+	_lastFix.valid = false;
+}
+
+bool DW1000Position::solve(const uint16_t addresses[], const float ranges[], const float weights[], uint8_t n, PositionFix &fix)
+{
+	// the ranges with a known anchor
+	uint8_t anchors[MAX_POSITION_ANCHORS];
+	float measured[MAX_POSITION_ANCHORS];
+	float weight[MAX_POSITION_ANCHORS];
+	uint8_t m = 0;
+	for (uint8_t i = 0; i < n && m < MAX_POSITION_ANCHORS; i++)
+	{
+		int8_t index = searchAnchor(addresses[i]);
+		if (index < 0 || weights[i] <= 0)
+		{
+			continue;
+		}
+		anchors[m] = index;
+		measured[m] = ranges[i];
+		weight[m] = weights[i];
+		m++;
+	}
+	fix.valid = false;
+	fix.anchors = m;
+	fix.iterations = 0;
+	if (m < _dimensions + 1)
+	{
+		return false;
+	}
+
+	// from the last fix, or from the centroid if there is none or it does not converge from there
+	float p[3];
+	bool converged = false;
+	if (_lastFix.valid)
+	{
+		p[0] = _lastFix.x;
+		p[1] = _lastFix.y;
+		p[2] = _lastFix.z;
+		converged = iterate(anchors, measured, weight, m, p, fix.iterations);
+	}
+	if (!converged)
+	{
+		// below the centroid, as anchors are usually mounted above the tags (and coplanar anchors
+		// would leave the height undetermined at the centroid)
+		p[0] = p[1] = p[2] = 0;
+		for (uint8_t i = 0; i < m; i++)
+		{
+			for (uint8_t k = 0; k < 3; k++)
+			{
+				p[k] += _anchors[anchors[i]][k] / m;
+			}
+		}
+		p[2] -= 1.0f;
+		converged = iterate(anchors, measured, weight, m, p, fix.iterations);
+	}
+	if (!converged)
+	{
+		return false;
+	}
+
+	// residuals and geometry at the solution, GDOP = sqrt(trace((J^T J)^-1))
+	uint8_t d = _dimensions;
+	float squares = 0;
+	float normal[3][3] = {};
+	for (uint8_t i = 0; i < m; i++)
+	{
+		const float *anchor = _anchors[anchors[i]];
+		float delta[3] = {p[0] - anchor[0], p[1] - anchor[1], p[2] - anchor[2]};
+		float distance = sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+		if (distance < 1e-3f)
+		{
+			distance = 1e-3f;
+		}
+		squares += (distance - measured[i]) * (distance - measured[i]);
+		for (uint8_t k = 0; k < d; k++)
+		{
+			for (uint8_t l = 0; l < d; l++)
+			{
+				normal[k][l] += delta[k] * delta[l] / (distance * distance);
+			}
+		}
+	}
+	float residual = sqrtf(squares / m);
+	if (residual > POSITION_MAX_RESIDUAL)
+	{
+		// the ranges do not fit together (e.g. a wrong anchor position or an NLOS range)
+		return false;
+	}
+	float trace = 0;
+	for (uint8_t k = 0; k < d; k++)
+	{
+		// column k of the inverse
+		float a[3][3];
+		float e[3] = {};
+		e[k] = 1;
+		for (uint8_t r = 0; r < d; r++)
+		{
+			for (uint8_t c = 0; c < d; c++)
+			{
+				a[r][c] = normal[r][c];
+			}
+		}
+		if (!solveLinear(a, e, d))
+		{
+			return false;
+		}
+		trace += e[k];
+	}
+
+	fix.valid = true;
+	fix.x = p[0];
+	fix.y = p[1];
+	fix.z = p[2];
+	fix.gdop = sqrtf(trace);
+	fix.residual = residual;
+	_lastFix = fix;
+	return true;
+}
+
+// Gauss-Newton from p, returns false if it does not converge within POSITION_MAX_ITERATIONS
+bool DW1000Position::iterate(const uint8_t anchors[], const float measured[], const float weight[], uint8_t m, float p[3], uint8_t &iterations)
+{
+	if (_dimensions == 2)
+	{
+		p[2] = _height;
+	}
+	uint8_t d = _dimensions;
+	for (uint8_t iteration = 0; iteration < POSITION_MAX_ITERATIONS; iteration++)
+	{
+		// normal equations J^T W J step = -J^T W r
+		float a[3][3] = {};
+		float b[3] = {};
+		float cost = 0;
+		for (uint8_t i = 0; i < m; i++)
+		{
+			const float *anchor = _anchors[anchors[i]];
+			float delta[3] = {p[0] - anchor[0], p[1] - anchor[1], p[2] - anchor[2]};
+			float distance = sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+			if (distance < 1e-3f)
+			{
+				distance = 1e-3f;
+			}
+			float residual = distance - measured[i];
+			cost += weight[i] * residual * residual;
+			float jacobian[3];
+			for (uint8_t k = 0; k < d; k++)
+			{
+				jacobian[k] = delta[k] / distance;
+			}
+			for (uint8_t k = 0; k < d; k++)
+			{
+				for (uint8_t l = 0; l < d; l++)
+				{
+					a[k][l] += weight[i] * jacobian[k] * jacobian[l];
+				}
+				b[k] -= weight[i] * jacobian[k] * residual;
+			}
+		}
+		float gradient[3] = {b[0], b[1], b[2]};
+		if (!solveLinear(a, b, d))
+		{
+			return false;
+		}
+
+		// J^T W J misses the curvature of the ranges, which is not small where the geometry is weak
+		// (e.g. the height with all anchors at similar heights): the full step overshoots or falls short
+		// and the iterations zigzag. The step is scaled to the minimum of a parabola through the cost
+		// at both ends and its slope at p.
+		float slope = 0;
+		float next[3] = {p[0], p[1], p[2]};
+		for (uint8_t k = 0; k < d; k++)
+		{
+			slope -= 2 * gradient[k] * b[k];
+			next[k] += b[k];
+		}
+		float curvature = getCost(anchors, measured, weight, m, next) - cost - slope;
+		float scale = curvature > 0 ? -slope / (2 * curvature) : 1;
+		scale = scale < POSITION_MIN_STEP_SCALE ? POSITION_MIN_STEP_SCALE : (scale > POSITION_MAX_STEP_SCALE ? POSITION_MAX_STEP_SCALE : scale);
+
+		float step = 0;
+		for (uint8_t k = 0; k < d; k++)
+		{
+			p[k] += scale * b[k];
+			step += scale * scale * b[k] * b[k];
+		}
+		iterations++;
+		if (step < POSITION_CONVERGED_STEP * POSITION_CONVERGED_STEP)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// weighted sum of the squared range residuals at p
+float DW1000Position::getCost(const uint8_t anchors[], const float measured[], const float weight[], uint8_t m, const float p[3])
+{
+	float cost = 0;
+	for (uint8_t i = 0; i < m; i++)
+	{
+		const float *anchor = _anchors[anchors[i]];
+		float delta[3] = {p[0] - anchor[0], p[1] - anchor[1], p[2] - anchor[2]};
+		float residual = sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]) - measured[i];
+		cost += weight[i] * residual * residual;
+	}
+	return cost;
+}
+
+// Gaussian elimination with partial pivoting, the solution replaces b
+bool DW1000Position::solveLinear(float a[3][3], float b[3], uint8_t n)
+{
+	for (uint8_t col = 0; col < n; col++)
+	{
+		uint8_t pivot = col;
+		for (uint8_t row = col + 1; row < n; row++)
+		{
+			if (fabsf(a[row][col]) > fabsf(a[pivot][col]))
+			{
+				pivot = row;
+			}
+		}
+		if (fabsf(a[pivot][col]) < 1e-6f)
+		{
+			return false;
+		}
+		for (uint8_t k = 0; k < n; k++)
+		{
+			float swap = a[col][k];
+			a[col][k] = a[pivot][k];
+			a[pivot][k] = swap;
+		}
+		float swap = b[col];
+		b[col] = b[pivot];
+		b[pivot] = swap;
+		for (uint8_t row = col + 1; row < n; row++)
+		{
+			float factor = a[row][col] / a[col][col];
+			for (uint8_t k = col; k < n; k++)
+			{
+				a[row][k] -= factor * a[col][k];
+			}
+			b[row] -= factor * b[col];
+		}
+	}
+	for (int8_t row = n - 1; row >= 0; row--)
+	{
+		for (uint8_t k = row + 1; k < n; k++)
+		{
+			b[row] -= a[row][k] * b[k];
+		}
+		b[row] /= a[row][row];
+	}
+	return true;
+}
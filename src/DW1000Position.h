@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+// anchors with known coordinates, at most one per network device (see MAX_DEVICES)
+#define MAX_POSITION_ANCHORS 12
+// Gauss-Newton iterations and the step (m) below which the solution counts as converged
+#define POSITION_MAX_ITERATIONS 15
+#define POSITION_CONVERGED_STEP 0.001f
+// bounds of the line search scale of a Gauss-Newton step
+#define POSITION_MIN_STEP_SCALE 0.25f
+#define POSITION_MAX_STEP_SCALE 2.0f
+// root mean square of the range residuals (m) above which a solution is rejected
+#define POSITION_MAX_RESIDUAL 1.0f
+
+// result of one multilateration
+struct PositionFix
+{
+	bool valid;
+	float x;
+	float y;
+	float z;
+	// geometric dilution of precision of the anchors used (horizontal only in 2D)
+	float gdop;
+	// root mean square of the range residuals, in m
+	float residual;
+	uint8_t anchors;
+	uint8_t iterations;
+};
+
+/**
+Position from ranges to anchors at known coordinates, by weighted Gauss-Newton least squares with a
+line search on fixed size matrices. In 2D the height of the tag is given, x and y are solved for 3D ranges.
+At least dimensions + 1 anchors are needed.
+*/
+class DW1000Position
+{
+public:
+	DW1000Position();
+
+	// anchor coordinates in m, returns false if the table is full
+	bool setAnchor(uint16_t shortAddress, float x, float y, float z);
+	void removeAnchor(uint16_t shortAddress);
+	void clearAnchors() { _anchorsNumber = 0; }
+	bool hasAnchor(uint16_t shortAddress) { return searchAnchor(shortAddress) >= 0; }
+
+	// 2 (x, y at the given height) or 3 (x, y, z)
+	void setDimensions(uint8_t dimensions, float height = 0);
+	uint8_t getDimensions() { return _dimensions; }
+
+	/**
+	Solves the position for n ranges (m) to anchors, each with a weight (e.g. the range score), ranges to
+	unknown anchors are skipped. The last valid fix is the starting point, or the centroid of the anchors
+	if there is none or the solution does not converge from it.
+
+	@return false if there are too few anchors, the geometry is degenerate, the solution does not converge
+	or its residual exceeds POSITION_MAX_RESIDUAL. The last valid fix is kept then.
+	*/
+	bool solve(const uint16_t addresses[], const float ranges[], const float weights[], uint8_t n, PositionFix &fix);
+
+private:
+	uint8_t _anchorsNumber;
+	uint16_t _anchorAddresses[MAX_POSITION_ANCHORS];
+	float _anchors[MAX_POSITION_ANCHORS][3];
+	uint8_t _dimensions;
+	float _height;
+	PositionFix _lastFix;
+
+	int8_t searchAnchor(uint16_t shortAddress);
+	bool iterate(const uint8_t anchors[], const float measured[], const float weight[], uint8_t m, float p[3], uint8_t &iterations);
+	float getCost(const uint8_t anchors[], const float measured[], const float weight[], uint8_t m, const float p[3]);
+	static bool solveLinear(float a[3][3], float b[3], uint8_t n);
+};
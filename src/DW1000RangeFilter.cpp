@@ -0,0 +1,207 @@
+#include "DW1000RangeFilter.h"
+
+// variance of the range rate of a newly started channel, (m/s)^2
+#define RANGE_FILTER_INITIAL_RATE_VARIANCE 1.0f
+
+DW1000RangeFilter::DW1000RangeFilter()
+{
+	_config = {0, 0, 0, 1, 0};
+	for (uint8_t i = 0; i < RANGE_FILTER_CHANNELS; i++)
+	{
+		reset(i);
+	}
+}
+
+void DW1000RangeFilter::configure(const RangeFilterConfig &config)
+{
+	_config = config;
+	if (_config.medianLength < 1)
+	{
+		_config.medianLength = 1;
+	}
+	else if (_config.medianLength > RANGE_FILTER_MEDIAN_MAX)
+	{
+		_config.medianLength = RANGE_FILTER_MEDIAN_MAX;
+	}
+	if (_config.measurementNoise <= 0)
+	{
+		// nothing to scale the gate with
+		_config.gateSigmas = 0;
+	}
+	for (uint8_t i = 0; i < RANGE_FILTER_CHANNELS; i++)
+	{
+		reset(i);
+	}
+}
+
+void DW1000RangeFilter::reset(uint8_t channel)
+{
+	if (channel >= RANGE_FILTER_CHANNELS)
+	{
+		return;
+	}
+	_range[channel] = 0;
+	_rate[channel] = 0;
+	_p00[channel] = 0;
+	_p01[channel] = 0;
+	_p11[channel] = 0;
+	_time[channel] = 0;
+	_initialized[channel] = 0;
+	_rejects[channel] = 0;
+	_windowCount[channel] = 0;
+	_windowHead[channel] = 0;
+}
+
+void DW1000RangeFilter::move(uint8_t from, uint8_t to)
+{
+	if (from >= RANGE_FILTER_CHANNELS || to >= RANGE_FILTER_CHANNELS || from == to)
+	{
+		return;
+	}
+	_range[to] = _range[from];
+	_rate[to] = _rate[from];
+	_p00[to] = _p00[from];
+	_p01[to] = _p01[from];
+	_p11[to] = _p11[from];
+	_time[to] = _time[from];
+	_initialized[to] = _initialized[from];
+	_rejects[to] = _rejects[from];
+	for (uint8_t k = 0; k < RANGE_FILTER_MEDIAN_MAX; k++)
+	{
+		_window[k][to] = _window[k][from];
+	}
+	_windowCount[to] = _windowCount[from];
+	_windowHead[to] = _windowHead[from];
+	reset(from);
+}
+
+void DW1000RangeFilter::start(uint8_t channel, uint32_t time, float range)
+{
+	_range[channel] = range;
+	_rate[channel] = 0;
+	_p00[channel] = _config.measurementNoise * _config.measurementNoise;
+	_p01[channel] = 0;
+	_p11[channel] = RANGE_FILTER_INITIAL_RATE_VARIANCE;
+	_time[channel] = time;
+	_initialized[channel] = 1;
+	_rejects[channel] = 0;
+	_window[0][channel] = range;
+	_windowCount[channel] = 1;
+	_windowHead[channel] = 1 % _config.medianLength;
+}
+
+bool DW1000RangeFilter::update(uint8_t channel, uint32_t time, float &range, float &rate)
+{
+	if (channel >= RANGE_FILTER_CHANNELS)
+	{
+		return true;
+	}
+	if (!_initialized[channel])
+	{
+		start(channel, time, range);
+		rate = 0;
+		return true;
+	}
+
+	bool kalman = _config.accelerationNoise > 0;
+	float r = _config.measurementNoise * _config.measurementNoise;
+	int32_t elapsed = (int32_t)(time - _time[channel]);
+	float dt = elapsed > 0 ? elapsed / 1000.0f : 0;
+
+	// prediction, without the Kalman filter the last output is the prediction
+	float predicted = _range[channel];
+	float p00 = _p00[channel];
+	float p01 = _p01[channel];
+	float p11 = _p11[channel];
+	if (kalman)
+	{
+		float q = _config.accelerationNoise * _config.accelerationNoise;
+		float dt2 = dt * dt;
+		predicted += _rate[channel] * dt;
+		p00 += dt * (2 * p01 + dt * p11) + q * dt2 * dt2 / 4;
+		p01 += dt * p11 + q * dt2 * dt / 2;
+		p11 += q * dt2;
+	}
+
+	// outlier gate
+	if (_config.gateSigmas > 0)
+	{
+		float innovation = range - predicted;
+		float variance = (kalman ? p00 : r) + r;
+		if (innovation * innovation > _config.gateSigmas * _config.gateSigmas * variance)
+		{
+			if (++_rejects[channel] <= _config.maxRejects)
+			{
+				return false;
+			}
+			// a lasting jump is no outlier, the filter lost track
+			start(channel, time, range);
+			rate = 0;
+			return true;
+		}
+	}
+	_rejects[channel] = 0;
+
+	// median
+	float z = range;
+	if (_config.medianLength > 1)
+	{
+		_window[_windowHead[channel]][channel] = range;
+		_windowHead[channel] = (_windowHead[channel] + 1) % _config.medianLength;
+		if (_windowCount[channel] < _config.medianLength)
+		{
+			_windowCount[channel]++;
+		}
+		z = median(channel);
+	}
+
+	// Kalman update
+	if (kalman)
+	{
+		float s = p00 + r;
+		float k0 = p00 / s;
+		float k1 = p01 / s;
+		float innovation = z - predicted;
+		_range[channel] = predicted + k0 * innovation;
+		_rate[channel] += k1 * innovation;
+		_p11[channel] = p11 - k1 * p01;
+		_p01[channel] = (1 - k0) * p01;
+		_p00[channel] = (1 - k0) * p00;
+	}
+	else
+	{
+		_range[channel] = z;
+	}
+	_time[channel] = time;
+	range = _range[channel];
+	rate = _rate[channel];
+	return true;
+}
+
+float DW1000RangeFilter::median(uint8_t channel)
+{
+	float sorted[RANGE_FILTER_MEDIAN_MAX];
+	uint8_t n = _windowCount[channel];
+	// insertion sort, a handful of values
+	for (uint8_t i = 0; i < n; i++)
+	{
+		float value = _window[i][channel];
+		uint8_t j = i;
+		while (j > 0 && sorted[j - 1] > value)
+		{
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = value;
+	}
+	return sorted[n / 2];
+}
+
+void DW1000RangeFilter::predict(uint32_t time, float ranges[])
+{
+	for (uint8_t i = 0; i < RANGE_FILTER_CHANNELS; i++)
+	{
+		float dt = (int32_t)(time - _time[i]) / 1000.0f;
+		ranges[i] = _range[i] + _rate[i] * dt;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+
+// one filter channel per network device (see MAX_DEVICES)
+#define RANGE_FILTER_CHANNELS 12
+// longest median window
+#define RANGE_FILTER_MEDIAN_MAX 7
+
+// stages of the range filter chain, a stage is off when its parameter is 0
+struct RangeFilterConfig
+{
+	// range noise in m (standard deviation), the scale of the outlier gate and of the Kalman filter
+	float measurementNoise;
+	// outlier gate: ranges further than gateSigmas standard deviations from the prediction are dropped
+	float gateSigmas;
+	// consecutive dropped ranges after which the filter restarts from the new ranges
+	uint8_t maxRejects;
+	// median of the last medianLength ranges (odd, up to RANGE_FILTER_MEDIAN_MAX, 1 for off)
+	uint8_t medianLength;
+	// constant velocity Kalman filter, acceleration noise in m/s^2 (standard deviation)
+	float accelerationNoise;
+};
+
+/**
+Range filter chain for every device: outlier gate, median of the last ranges, then a 1D constant
+velocity Kalman filter giving the range and its rate of change.
+
+The state of all channels lives in fixed arrays, one entry per channel in each, so nothing is
+allocated and the loops over all channels (predict()) run over contiguous memory.
+*/
+class DW1000RangeFilter
+{
+public:
+	DW1000RangeFilter();
+
+	void configure(const RangeFilterConfig &config);
+	const RangeFilterConfig &getConfig() { return _config; }
+	bool isEnabled() { return _config.gateSigmas > 0 || _config.medianLength > 1 || _config.accelerationNoise > 0; }
+
+	// forget the history of a channel, e.g. a new device took it
+	void reset(uint8_t channel);
+	// the device of a channel moved to another one
+	void move(uint8_t from, uint8_t to);
+
+	/**
+	Filters a new range of a channel measured at time (ms).
+
+	@return false if the range was dropped as outlier, range and rate are left untouched then.
+	*/
+	bool update(uint8_t channel, uint32_t time, float &range, float &rate);
+
+	// filtered range of every channel extrapolated to time, for a position fix at a common epoch
+	void predict(uint32_t time, float ranges[]);
+
+private:
+	RangeFilterConfig _config;
+	// Kalman state and covariance
+	float _range[RANGE_FILTER_CHANNELS];
+	float _rate[RANGE_FILTER_CHANNELS];
+	float _p00[RANGE_FILTER_CHANNELS];
+	float _p01[RANGE_FILTER_CHANNELS];
+	float _p11[RANGE_FILTER_CHANNELS];
+	uint32_t _time[RANGE_FILTER_CHANNELS];
+	uint8_t _initialized[RANGE_FILTER_CHANNELS];
+	uint8_t _rejects[RANGE_FILTER_CHANNELS];
+	// median window, ring buffer per channel
+	float _window[RANGE_FILTER_MEDIAN_MAX][RANGE_FILTER_CHANNELS];
+	uint8_t _windowCount[RANGE_FILTER_CHANNELS];
+	uint8_t _windowHead[RANGE_FILTER_CHANNELS];
+
+	void start(uint8_t channel, uint32_t time, float range);
+	float median(uint8_t channel);
+};
@@ -3,24 +3,86 @@
 #include "DW1000Device.h"
 
 void DW1000Ranging::init(BoardType type, uint16_t shortAddress, const char *wifiMacAddress, bool high_power, const uint8_t mode[], uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
+{
+	init(type, shortAddress, wifiMacAddress, high_power, DW1000::getModeProfile(mode), myRST, mySS, myIRQ, payload);
+}
+
+void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const uint8_t mode[], uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
+{
+	init(type, wifiMacAddress, shortAddress, high_power, DW1000::getModeProfile(mode), myRST, mySS, myIRQ, payload);
+}
+
+void DW1000Ranging::init(BoardType type, uint16_t shortAddress, const char *wifiMacAddress, bool high_power, const RadioProfile &profile, uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
 {
 	uint8_t byteWifiMacAddress[6] = {0};
 	pDW1000.convertToByte(wifiMacAddress, byteWifiMacAddress, 6);
-	init(type, byteWifiMacAddress, shortAddress, high_power, mode, myRST, mySS, myIRQ, payload);
+	init(type, byteWifiMacAddress, shortAddress, high_power, profile, myRST, mySS, myIRQ, payload);
 }
 
-void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const uint8_t mode[], uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
+void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
+{
+	initState(wifiMacAddress, shortAddress, high_power, profile, payload);
+	initCommunication(myRST, mySS, myIRQ);
+	pDW1000.begin();
+	completeInit(type, shortAddress);
+}
+
+void DW1000Ranging::initAsync(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, void (*handleReady)(bool), uint8_t myRST, uint8_t mySS, uint8_t myIRQ, float payload)
+{
+	initState(wifiMacAddress, shortAddress, high_power, profile, payload);
+	initCommunication(myRST, mySS, myIRQ);
+	// the bring-up steps are run by loop()
+	pDW1000.beginAsync([this, type, shortAddress, handleReady](bool ok)
+					   {
+		if (ok)
+			completeInit(type, shortAddress);
+		else
+			_portable.log_err(DW_RANGING, "DW1000 not found");
+		if (handleReady != 0)
+			(*handleReady)(ok); });
+}
+
+void DW1000Ranging::initState(const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, float payload)
 {
 	for (int i = 0; i < MAX_DEVICES; i++)
 		_networkDevices.push_back(DW1000Device(_portable));
 
 	_networkDevicesNumber = 0;
+	_started = false;
 	_sentAck = false;
 	_receivedAck = false;
+	_receiveTimedOut = false;
+	_boundedReceive = false;
+	_doubleBufferedReceive = false;
+	_waitForResponse = false;
 	_protocolFailed = false;
-	lastTimerTick = 0;
-	_replyTimeOfLastPollAck = 0;
-	_timeOfLastPollSent = 0;
+	_exchangeState = ExchangeState::IDLE;
+	_exchangeRetries = 0;
+	_failedExchanges = 0;
+	_warmRestartUnconfirmed = false;
+	_antennaCalibrating = false;
+	_calibrationSamples = 0;
+	_crystalCalibrating = false;
+	_crystalReference = 0;
+	_crystalFrames = 0;
+	_crystalSamples = 0;
+	_crystalOffsetSum = 0;
+	_crystalOffset = 0;
+	_crystalRepeatPeriod = 0;
+	_crystalCalibrationDue = 0;
+	_temperatureCorrection = false;
+	_delayCoefficient = 0;
+	_rangeCoefficient = 0;
+	_referenceTemperature = 23.0f;
+	_temperaturePeriod = DEFAULT_TEMPERATURE_PERIOD;
+	_temperatureDue = 0;
+	_temperature = _referenceTemperature;
+	_voltage = 0;
+	_baseAntennaDelay = 0;
+	_polledDevicesNumber = 0;
+	_answeredDevicesNumber = 0;
+	_reportedDevicesNumber = 0;
+	memset(&_counters, 0, sizeof(_counters));
 	counterForBlink = 0; // TODO 8 bit?
 	_rangeInterval = DEFAULT_RANGE_INTERVAL;
 	_rangingCountPeriod = 0;
@@ -32,9 +94,21 @@ void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t
 	_handleRemovedDeviceMaxReached = 0;
 	_payload = payload;
 	_requestTimeoutExtention = 0;
-	_first = true;
-
-	initCommunication(myRST, mySS, myIRQ);
+	_handleRoundEnergy = 0;
+	_handleTdoaRecord = 0;
+	_listenMode = ListenMode::CONTINUOUS;
+	_powerMode = PowerMode::ALWAYS_ON;
+	_radioState = RadioState::IDLE;
+	memset(&_roundEnergy, 0, sizeof(_roundEnergy));
+	memset(&_lastRoundEnergy, 0, sizeof(_lastRoundEnergy));
+	_profile = profile;
+	_highPower = high_power;
+	_rangingMode = RangingMode::DS_TWR_ASYMMETRIC;
+	_tdoaListener = false;
+	_rangeReportMode = RangeReportMode::NONE;
+	_pendingReportsNumber = 0;
+	for (uint8_t i = 0; i < MAX_SESSIONS; i++)
+		_sessions[i].state = SessionState::FREE;
 
 	// convert the address
 	pDW1000.convertToByte(shortAddress, _ownLongAddress);
@@ -49,16 +123,19 @@ void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t
 	// we use first two bytes in address for short address
 	_ownShortAddress[0] = _ownLongAddress[0];
 	_ownShortAddress[1] = _ownLongAddress[1];
+}
 
+void DW1000Ranging::completeInit(BoardType type, uint16_t shortAddress)
+{
 	// write the address on the DW1000 chip
 	pDW1000.setEUI(_ownLongAddress);
 
 	// we configure the network for mac filtering
 	//(device Address, network ID, frequency)
-	configureNetwork(shortAddress, 0xDECA, mode);
+	configureNetwork(shortAddress, 0xDECA, _profile);
 
 	// general start
-	generalStart(high_power);
+	generalStart(_highPower);
 
 	// defined type
 	_type = type;
@@ -71,6 +148,15 @@ void DW1000Ranging::init(BoardType type, const uint8_t *wifiMacAddress, uint16_t
 	char msg[6];
 	sprintf(msg, "%02X:%02X", _ownShortAddress[0], _ownShortAddress[1]);
 	_portable.log_inf(DW_RANGING, "Short address: %s", msg);
+	_started = true;
+}
+
+bool DW1000Ranging::checkStarted(const char *setting)
+{
+	if (_started)
+		return true;
+	_portable.log_war(DW_RANGING, "%s ignored, the chip is not configured yet", setting);
+	return false;
 }
 
 /* ###########################################################################
@@ -87,18 +173,31 @@ void DW1000Ranging::initCommunication(uint8_t myRST, uint8_t mySS, uint8_t myIRQ
 	// we set our timer delay
 	_timerDelay = _rangeInterval;
 
-	pDW1000.begin();
+	// loop() is the only one talking to the chip, the interrupt task just flags the interrupt
+	pDW1000.setDeferredInterrupts(true);
 }
 
-void DW1000Ranging::configureNetwork(uint16_t deviceAddress, uint16_t networkId, const uint8_t mode[])
+void DW1000Ranging::configureNetwork(uint16_t deviceAddress, uint16_t networkId, const RadioProfile &profile)
 {
 	// general configuration
 	pDW1000.newConfiguration();
 	pDW1000.setDefaults();
 	pDW1000.setDeviceAddress(deviceAddress);
 	pDW1000.setNetworkId(networkId);
-	pDW1000.enableMode(mode);
+	pDW1000.enableProfile(profile);
+	pDW1000.setDoubleBuffering(_doubleBufferedReceive);
+	pDW1000.commitConfiguration();
+}
+
+void DW1000Ranging::setDoubleBufferedReceive(bool val)
+{
+	if (!checkStarted("double buffered receive"))
+		return;
+	_doubleBufferedReceive = val;
+	pDW1000.newConfiguration();
+	pDW1000.setDoubleBuffering(val);
 	pDW1000.commitConfiguration();
+	receiver();
 }
 
 void DW1000Ranging::generalStart(bool high_power)
@@ -108,15 +207,26 @@ void DW1000Ranging::generalStart(bool high_power)
 							  { handleSent(); });
 	pDW1000.attachReceivedHandler([&]()
 								  { handleReceived(); });
+	pDW1000.attachReceiveFailedHandler([&]()
+									   { handleReceiveFailed(); });
+	pDW1000.attachReceiveTimeoutHandler([&]()
+										{ handleReceiveTimeout(); });
 	// anchor starts in receiving mode, awaiting a ranging poll message
 
 	if (high_power)
 		pDW1000.high_power_init();
 
 	// anchor starts in receiving mode, awaiting a ranging poll message
+	_radioStateSince = _portable.micros();
 	receiver();
 	// for first time ranging frequency computation
 	_rangingCountPeriod = _portable.millis();
+
+	// all the protocol deadlines run on the timer wheel, the first tick is due right away
+	_timers.reset(_rangingCountPeriod);
+	_timers.attachExpiredHandler([&](uint16_t id)
+								 { handleTimerExpired(id); });
+	_timers.arm(timerTickId, 0);
 }
 
 bool DW1000Ranging::addNetworkDevices(DW1000Device *device)
@@ -142,6 +252,8 @@ bool DW1000Ranging::addNetworkDevices(DW1000Device *device)
 	{
 		memcpy((void *)&_networkDevices[_networkDevicesNumber], device, sizeof(DW1000Device));
 		_networkDevices[_networkDevicesNumber].setIndex(_networkDevicesNumber);
+		_rangeFilter.reset(_networkDevicesNumber);
+		_timers.arm(deviceTimerId + _networkDevicesNumber, INACTIVITY_TIME + 1);
 		_networkDevicesNumber += 1;
 	}
 	else
@@ -153,17 +265,26 @@ bool DW1000Ranging::addNetworkDevices(DW1000Device *device)
 		}
 		memcpy((void *)&_networkDevices[worstQuality], device, sizeof(DW1000Device));
 		_networkDevices[worstQuality].setIndex(worstQuality);
+		_rangeFilter.reset(worstQuality);
+		_timers.arm(deviceTimerId + worstQuality, INACTIVITY_TIME + 1);
 	}
 	return true;
 }
 
 void DW1000Ranging::removeNetworkDevices(uint8_t index)
 {
+	_timers.cancel(deviceTimerId + index);
 	if (index != _networkDevicesNumber - 1) // if we do not delete the last element
 	{
-		// we replace the element we want to delete with the last one
+		// we replace the element we want to delete with the last one, its timer follows it
 		memcpy((void *)&_networkDevices[index], &_networkDevices[_networkDevicesNumber - 1], sizeof(DW1000Device));
 		_networkDevices[index].setIndex(index);
+		_timers.move(deviceTimerId + _networkDevicesNumber - 1, deviceTimerId + index);
+		_rangeFilter.move(_networkDevicesNumber - 1, index);
+	}
+	else
+	{
+		_rangeFilter.reset(index);
 	}
 	_networkDevicesNumber -= 1;
 }
@@ -203,27 +324,68 @@ void DW1000Ranging::checkForReset()
 	}
 }
 
-void DW1000Ranging::checkForInactiveDevices()
+void DW1000Ranging::handleTimerExpired(uint16_t id)
 {
-	uint8_t inactiveDevicesNum = 0;
-	uint8_t inactiveDevices[MAX_DEVICES];
-	for (uint8_t i = 0; i < _networkDevicesNumber; i++)
+	if (id == timerTickId)
 	{
-		if (_networkDevices[i].isInactive())
+		closeEnergyRound();
+		bool dutyCycled = _type == BoardType::TAG && _powerMode == PowerMode::DUTY_CYCLED;
+		if (dutyCycled)
+			wakeRadio(); // in case the wake-up timer was late
+		timerTick();
+		// timerTick() may have changed the delay for the next round
+		_timers.arm(timerTickId, _timerDelay + 1);
+		if (dutyCycled)
 		{
-			inactiveDevices[inactiveDevicesNum++] = i;
-			if (_handleInactiveDevice != 0)
-			{
-				(*_handleInactiveDevice)(&_networkDevices[i]);
-			}
+			if (_radioState == RadioState::IDLE)
+				sleepRadio(); // nothing sent, nothing to listen for
+			if (_timerDelay + 1 > wakeupLeadTime)
+				_timers.arm(wakeupTimerId, _timerDelay + 1 - wakeupLeadTime);
 		}
 	}
+	else if (id == exchangeTimerId)
+	{
+		handleExchangeTimeout();
+	}
+	else if (id == wakeupTimerId)
+	{
+		wakeRadio();
+	}
+	else if (id == sleepTimerId)
+	{
+		// an exchange in progress puts the radio to sleep once it is over
+		if (_exchangeState == ExchangeState::IDLE && !_sentAck && !_receivedAck)
+			sleepRadio();
+	}
+	else if (id < deviceTimerId)
+	{
+		handleSessionTimeout(id - sessionTimerId);
+	}
+	else
+	{
+		handleDeviceTimeout(id - deviceTimerId);
+	}
+}
 
-	// we need to delete the device from the array:
-	for (uint8_t i = 0; i < inactiveDevicesNum; i++)
+void DW1000Ranging::handleDeviceTimeout(uint8_t index)
+{
+	if (index >= _networkDevicesNumber)
+		return;
+
+	DW1000Device *device = &_networkDevices[index];
+	uint32_t currentTime = _timers.getTime();
+	if (!device->isInactive(currentTime))
 	{
-		removeNetworkDevices(inactiveDevices[i]);
+		// heard from it meanwhile, wait for a full inactivity period since then
+		_timers.armAt(deviceTimerId + index, device->getLastActivity() + INACTIVITY_TIME + 1);
+		return;
 	}
+
+	if (_handleInactiveDevice != 0)
+	{
+		(*_handleInactiveDevice)(device);
+	}
+	removeNetworkDevices(index);
 }
 
 MessageType DW1000Ranging::detectMessageType(uint8_t datas[])
@@ -245,40 +407,25 @@ MessageType DW1000Ranging::detectMessageType(uint8_t datas[])
 	return MessageType::TYPE_ERROR;
 }
 
-uint32_t DEBUGtimePollSent;
-uint32_t DEBUGRangeSent;
-
 void DW1000Ranging::loop()
 {
+	// asynchronous bring-up still running, or it failed
+	if (pDW1000.serviceBringUp() || !_started)
+		return;
 	// we check if needed to reset!
 	checkForReset();
-	uint32_t currentTime = _portable.millis();
-
-	if (currentTime - lastTimerTick > _timerDelay)
-	{
-		lastTimerTick = currentTime;
-		timerTick();
-	}
-	if (!_sentAck && !_receivedAck)
+	pDW1000.serviceInterrupts();
+	// timer tick, device inactivity and exchange deadlines, after the replies (delayed TX) to received frames
+	if (!_receivedAck)
+		_timers.advance(_portable.millis());
+	if (_receiveTimedOut)
 	{
-		if (_replyTimeOfLastPollAck != 0 && currentTime - _timeOfLastPollSent > _replyTimeOfLastPollAck + 3)
-		{
-
-			if (_type == BoardType::TAG && _first)
-			{
-				_portable.log_inf(DW_RANGING, "Its quite long anyone sent ACK, reset DWM", _networkDevicesNumber);
-				pDW1000.select();
-				_first = false;
-				if (_requestTimeoutExtention != 0)
-					(*_requestTimeoutExtention)();
-				// we may need to ask extention of entering sleep???
-
-				// receiver(); // may be we were deaf that is why we could not hear anyone ???
-			}
-
-			//			_portable.log_inf(DW_RANGING,  "RANGE ON TIMEOUT");
-			//			transmitRange();
-		}
+		_receiveTimedOut = false;
+		_counters.receiveTimeouts++;
+		// the chip turned the receiver off
+		setRadioState(RadioState::IDLE);
+		// the receive window closed, no need to wait for the deadline
+		handleExchangeTimeout();
 	}
 	if (_sentAck)
 	{
@@ -305,6 +452,15 @@ void DW1000Ranging::loop()
 		case MessageType::RANGING_INIT:
 			_portable.log_dbg(DW_RANGING, "RANGING_INIT");
 			break;
+		case MessageType::POLL_SS:
+			_portable.log_dbg(DW_RANGING, "POLL_SS");
+			break;
+		case MessageType::POLL_ACK_SS:
+			_portable.log_dbg(DW_RANGING, "POLL_ACK_SS");
+			break;
+		case MessageType::RANGE_REPORT_AGGREGATED:
+			_portable.log_dbg(DW_RANGING, "RANGE_REPORT_AGGREGATED");
+			break;
 		case MessageType::TYPE_ERROR:
 			_portable.log_dbg(DW_RANGING, "TYPE_ERROR");
 			break;
@@ -313,11 +469,12 @@ void DW1000Ranging::loop()
 			break;
 		};
 
-		if (messageType != MessageType::POLL_ACK && messageType != MessageType::POLL && messageType != MessageType::RANGE)
+		if (messageType != MessageType::POLL_ACK && messageType != MessageType::POLL && messageType != MessageType::RANGE &&
+			messageType != MessageType::POLL_SS && messageType != MessageType::POLL_ACK_SS)
 			return;
 
 		// A msg was sent. We launch the ranging protocol when a message was sent
-		if (_type == BoardType::ANCHOR && messageType == MessageType::POLL_ACK)
+		if (_type == BoardType::ANCHOR && (messageType == MessageType::POLL_ACK || messageType == MessageType::POLL_ACK_SS))
 		{
 			uint8_t tagAddr[2];
 			tagAddr[0] = sentData[6];
@@ -327,6 +484,24 @@ void DW1000Ranging::loop()
 			DW1000Device *myDistantDevice = searchDistantDevice(tagAddr);
 			if (myDistantDevice)
 				pDW1000.getTransmitTimestamp(myDistantDevice->timePollAckSent);
+
+			RangingSession *session = searchSession(tagAddr, SessionState::ACK_SCHEDULED);
+			if (session != nullptr)
+			{
+				if (session->singleSided)
+				{
+					// the tag computes the range on its own, nothing more to expect
+					closeSession(session);
+				}
+				else
+				{
+					pDW1000.getTransmitTimestamp(session->timePollAckSent);
+					session->state = SessionState::RANGE_EXPECTED;
+					armSessionTimer(session, sessionRangeTimeout);
+				}
+			}
+			// the radio is free again, send the next POLL_ACK in line (if any)
+			scheduleNextPollAck();
 		}
 		else if (_type == BoardType::TAG)
 		{
@@ -334,7 +509,7 @@ void DW1000Ranging::loop()
 			{
 				receiver();
 			}
-			else if (messageType == MessageType::POLL)
+			else if (messageType == MessageType::POLL || messageType == MessageType::POLL_SS)
 			{
 				DW1000Time timePollSent;
 				pDW1000.getTransmitTimestamp(timePollSent);
@@ -347,7 +522,20 @@ void DW1000Ranging::loop()
 					_networkDevices[i].hasSentPollAck = false;
 					_networkDevices[i].hasRangeBeenServed = false;
 				}
-				receiver();
+				// with _waitForResponse the chip has already turned the receiver on, or will do so in time
+				if (_boundedReceive && _polledDevicesNumber > 0)
+				{
+					// listen from the first reply slot to the end of the last one
+					DW1000Time windowStart = timePollSent + DW1000Time((int32_t)getPollAckWindowStart(), DW1000Time::MICROSECONDS);
+					if (_waitForResponse)
+						pDW1000.setReceiveWindowEnd(windowStart + DW1000Time((int32_t)getPollAckWindowLength(), DW1000Time::MICROSECONDS));
+					else
+						openReceiveWindow(windowStart, getPollAckWindowLength());
+				}
+				else if (!_waitForResponse)
+				{
+					receiver();
+				}
 			}
 			else if (messageType == MessageType::RANGE)
 			{
@@ -369,6 +557,19 @@ void DW1000Ranging::loop()
 	{
 		_receivedAck = false;
 
+		if (_doubleBufferedReceive)
+		{
+			// one frame per loop, in order of arrival
+			if (!pDW1000.nextReceivedFrame())
+			{
+				return;
+			}
+			if (pDW1000.getReceivedFramesNumber() > 0)
+			{
+				_receivedAck = true;
+			}
+		}
+
 		// we read the datas from the modules:
 		//  get message and parse
 		pDW1000.getData(receivedData, LEN_DATA);
@@ -395,6 +596,15 @@ void DW1000Ranging::loop()
 		case MessageType::RANGING_INIT:
 			_portable.log_dbg(DW_RANGING, "<=RANGING_INIT");
 			break;
+		case MessageType::POLL_SS:
+			_portable.log_dbg(DW_RANGING, "<=POLL_SS");
+			break;
+		case MessageType::POLL_ACK_SS:
+			_portable.log_dbg(DW_RANGING, "<=POLL_ACK_SS");
+			break;
+		case MessageType::RANGE_REPORT_AGGREGATED:
+			_portable.log_dbg(DW_RANGING, "<=RANGE_REPORT_AGGREGATED");
+			break;
 		case MessageType::TYPE_ERROR:
 			_portable.log_dbg(DW_RANGING, "<=TYPE_ERROR");
 			break;
@@ -403,8 +613,14 @@ void DW1000Ranging::loop()
 			break;
 		};
 
+		if (_tdoaListener && _type == BoardType::ANCHOR)
+		{
+			// nothing but BLINKs matter to a listener
+			if (messageType == MessageType::BLINK)
+				receiveTdoaBlink();
+		}
 		// we have just received a BLINK message from tag
-		if (messageType == MessageType::BLINK && _type == BoardType::ANCHOR) // At the ANCHOR side, we received this we check if TAG knows us, if not, we send a RANGING_INIT
+		else if (messageType == MessageType::BLINK && _type == BoardType::ANCHOR) // At the ANCHOR side, we received this we check if TAG knows us, if not, we send a RANGING_INIT
 		{
 			uint8_t tagAddr[2];
 			_globalMac.decodeBlinkFrame(receivedData, tagAddr);
@@ -434,7 +650,7 @@ void DW1000Ranging::loop()
 				(*_handleBlinkDevice)(&myTag);
 			}
 
-			if (!knownByTheTag) // if TAG does not know us, ask it to notedown by sending a RANGING_INIT
+			if (!knownByTheTag && !isPollAckScheduled()) // if TAG does not know us, ask it to notedown by sending a RANGING_INIT
 			{
 				// we reply by the transmit ranging init message
 				_portable.log_vrb(DW_RANGING, "Sending RANGING_INIT to %02x:%02x", tagAddr[0], tagAddr[1]);
@@ -473,6 +689,7 @@ void DW1000Ranging::loop()
 			// we have a short mac layer frame !
 			uint8_t address[2];
 			_globalMac.decodeShortMACFrame(receivedData, address);
+			sampleCrystalOffset(address);
 
 			// we get the device which correspond to the message which was sent (need to be filtered by MAC address)
 			//	DW1000Device *myDistantDevice = searchDistantDevice(address);
@@ -480,7 +697,7 @@ void DW1000Ranging::loop()
 			// then we proceed to range protocol
 			if (_type == BoardType::ANCHOR)
 			{
-				if (messageType == MessageType::POLL)
+				if (messageType == MessageType::POLL || messageType == MessageType::POLL_SS)
 				{
 					// we receive a POLL which is a broadcast message
 					// we need to grab info about it
@@ -519,7 +736,25 @@ void DW1000Ranging::loop()
 							uint16_t replyTime;
 							memcpy(&replyTime, receivedData + SHORT_MAC_LEN + 2 + 2 + i * pollDeviceSize, 2);
 							myDistantDevice->timePollReceived = timePollReceived;
-							transmitPollAck(myDistantDevice, replyTime); // Acknowledge the POLL message
+
+							RangingSession *session = openSession(address);
+							if (session == nullptr)
+							{
+								_portable.log_war(DW_RANGING, "No free session for %x:%x, POLL ignored", address[0], address[1]);
+								return;
+							}
+							session->singleSided = (messageType == MessageType::POLL_SS);
+							session->timePollReceived = timePollReceived;
+							// the reply slot is relative to the POLL reception, not to when we got to handle it
+							session->timePollAckDue = timePollReceived + DW1000Time(replyTime, DW1000Time::MICROSECONDS);
+							session->timePollAckDue.setTimestamp(session->timePollAckDue.getTimestamp() % DW1000Time::TIME_OVERFLOW);
+							armSessionTimer(session, replyTime / 1000 + sessionAckTimeout);
+							_globalMac.generateShortMACFrame(session->ackFrame, _ownShortAddress, address);
+							session->ackFrame[SHORT_MAC_LEN] = static_cast<uint8_t>(session->singleSided ? MessageType::POLL_ACK_SS : MessageType::POLL_ACK);
+							session->state = SessionState::POLL_RECEIVED;
+
+							// Acknowledge the POLL message, right away or once the radio is free
+							scheduleNextPollAck();
 
 							noteActivity();
 
@@ -548,17 +783,30 @@ void DW1000Ranging::loop()
 							shortAddress[1] == _ownShortAddress[1])
 						{
 							DW1000Device *myDistantDevice = searchDistantDevice(address);
+							RangingSession *session = searchSession(address, SessionState::RANGE_EXPECTED);
+							if (myDistantDevice != nullptr && session == nullptr)
+							{
+								// the exchange timed out or was never acknowledged by us
+								_portable.log_war(DW_RANGING, "RANGE received from TAG %x:%x without an open session", address[0], address[1]);
+								return;
+							}
 							if (myDistantDevice != nullptr)
 							{ // Cannot be a nullptr as we should have cached the TAG when we received the POLL
 
 								myDistantDevice->noteActivity();
 
+								// timestamps of this very exchange
+								myDistantDevice->timePollReceived = session->timePollReceived;
+								myDistantDevice->timePollAckSent = session->timePollAckSent;
+								closeSession(session);
+
 								// we grab the replytime which is for us
 								myDistantDevice->timeRangeReceived = timeRangeReceived;
 
-								myDistantDevice->setRXPower(pDW1000.getReceivePower());
-								myDistantDevice->setFPPower(pDW1000.getFirstPathPower());
-								myDistantDevice->setQuality(pDW1000.getReceiveQuality());
+								FramePowers powers = readFramePowers();
+								myDistantDevice->setRXPower(powers.rxPower);
+								myDistantDevice->setFPPower(powers.fpPower);
+								myDistantDevice->setQuality(powers.quality);
 
 								myDistantDevice->timePollAckReceivedMinusPollSent.setTimestamp(receivedData + SHORT_MAC_LEN + 4 + rangeDeviceSize * i);
 								myDistantDevice->timeRangeSentMinusPollAckReceived.setTimestamp(receivedData + SHORT_MAC_LEN + 9 + rangeDeviceSize * i);
@@ -567,27 +815,31 @@ void DW1000Ranging::loop()
 								DW1000Time myTOF;
 								computeRangeAsymmetric(myDistantDevice, &myTOF); // CHOSEN RANGING ALGORITHM
 
-								float distance = myTOF.getAsMeters();
+								float rawRange = myTOF.getAsMeters();
+								float distance = correctRange(rawRange);
 
 								float payload;
 								memcpy(&payload, receivedData + SHORT_MAC_LEN + 14 + rangeDeviceSize * i, 4);
 
 								myDistantDevice->setPayload(payload);
-								myDistantDevice->setRange(distance);
 
 								noteActivity();
 
-								if (ENABLE_RANGE_REPORT)
+								if (_rangeReportMode == RangeReportMode::UNICAST && !isPollAckScheduled())
 								{
 									uint16_t replyTime = getReplyTimeOfIndex(i);
 
 									// we send the range to TAG
-									transmitRangeReport(myDistantDevice, replyTime);
+									transmitRangeReport(myDistantDevice, distance, replyTime);
+								}
+								else if (_rangeReportMode == RangeReportMode::AGGREGATED)
+								{
+									// sent with the others on the next timer tick
+									queueRangeReport(myDistantDevice, distance);
 								}
 
 								// we have finished our range computation. We send the corresponding handler
-								if (_handleNewRange != 0)
-									(*_handleNewRange)(myDistantDevice);
+								handleNewRange(myDistantDevice, distance, rawRange, powers);
 							}
 							else
 							{
@@ -603,6 +855,41 @@ void DW1000Ranging::loop()
 			}
 			else if (_type == BoardType::TAG)
 			{
+				if (messageType == MessageType::RANGE_REPORT_AGGREGATED) // broadcast, look for our own entry
+				{
+					DW1000Device *myDistantDevice = searchDistantDevice(address);
+					if (myDistantDevice == nullptr)
+						return;
+
+					uint8_t numberReports = receivedData[SHORT_MAC_LEN + 1];
+					if (numberReports > maxAggregatedReports)
+						return;
+
+					for (uint8_t i = 0; i < numberReports; i++)
+					{
+						uint8_t *report = receivedData + SHORT_MAC_LEN + 2 + i * rangeReportEntrySize;
+						if (report[0] != _ownShortAddress[0] || report[1] != _ownShortAddress[1])
+							continue;
+
+						float curRange;
+						memcpy(&curRange, report + 2, 4);
+						float curRXPower;
+						memcpy(&curRXPower, report + 6, 4);
+
+						FramePowers powers = readFramePowers();
+						myDistantDevice->setRXPower(curRXPower);
+						// the report came over the same link, its first path tells about the ranging frames
+						myDistantDevice->setFPPower(powers.fpPower);
+						myDistantDevice->setQuality(powers.quality);
+						myDistantDevice->noteActivity();
+
+						// as the anchor computed it, its temperature correction cannot be undone here
+						handleNewRange(myDistantDevice, curRange, curRange, powers);
+						break;
+					}
+					return;
+				}
+
 				// if message was not for us, ignore?
 				if (receivedData[6] != _ownShortAddress[0] || receivedData[5] != _ownShortAddress[1])
 					return;
@@ -615,18 +902,60 @@ void DW1000Ranging::loop()
 					{
 						pDW1000.getReceiveTimestamp(myDistantDevice->timePollAckReceived);
 						myDistantDevice->noteActivity();
+						if (!myDistantDevice->hasSentPollAck)
+							_answeredDevicesNumber++;
 						myDistantDevice->hasSentPollAck = true;
 
 						noteActivity();
 						_portable.log_inf(DW_RANGING, "RANGE on POLL_ACK");
 
 						transmitRange();
+						if (_answeredDevicesNumber >= _polledDevicesNumber)
+							finishPollAckPhase();
 					}
 					else
 					{
 						_portable.log_err(DW_RANGING, "POLL_ACK received, but the anchor %x:%x not found in database", address[0], address[1]);
 					}
 				}
+				else if (messageType == MessageType::POLL_ACK_SS) // single-sided two-way ranging, we compute the range ourselves
+				{
+					DW1000Device *myDistantDevice = searchDistantDevice(address);
+
+					if (myDistantDevice != nullptr)
+					{
+						pDW1000.getReceiveTimestamp(myDistantDevice->timePollAckReceived);
+						// the responder clock offset, as seen by our receiver
+						myDistantDevice->updateClockOffset(pDW1000.getClockOffset());
+						FramePowers powers = readFramePowers();
+						myDistantDevice->setRXPower(powers.rxPower);
+						myDistantDevice->setFPPower(powers.fpPower);
+						myDistantDevice->setQuality(powers.quality);
+
+						myDistantDevice->timePollReceived.setTimestamp(receivedData + SHORT_MAC_LEN + 1);
+						myDistantDevice->timePollAckSent.setTimestamp(receivedData + SHORT_MAC_LEN + 6);
+						myDistantDevice->noteActivity();
+						if (!myDistantDevice->hasSentPollAck)
+							_answeredDevicesNumber++;
+						myDistantDevice->hasSentPollAck = true;
+						myDistantDevice->hasRangeBeenServed = true;
+
+						DW1000Time myTOF;
+						computeRangeSingleSided(myDistantDevice, &myTOF);
+						float rawRange = myTOF.getAsMeters();
+
+						noteActivity();
+
+						handleNewRange(myDistantDevice, correctRange(rawRange), rawRange, powers);
+
+						if (_answeredDevicesNumber >= _polledDevicesNumber)
+							finishPollAckPhase();
+					}
+					else
+					{
+						_portable.log_err(DW_RANGING, "POLL_ACK_SS received, but the anchor %x:%x not found in database", address[0], address[1]);
+					}
+				}
 				else if (messageType == MessageType::RANGE_REPORT) // TODO: Later
 				{
 					float curRange;
@@ -639,15 +968,20 @@ void DW1000Ranging::loop()
 					if (myDistantDevice != nullptr)
 					{
 						// we have a new range to save !
-						myDistantDevice->setRange(curRange);
+						FramePowers powers = readFramePowers();
 						myDistantDevice->setRXPower(curRXPower);
+						// the report came over the same link, its first path tells about the ranging frames
+						myDistantDevice->setFPPower(powers.fpPower);
+						myDistantDevice->setQuality(powers.quality);
+						myDistantDevice->noteActivity();
+
+						_reportedDevicesNumber++;
+						if (_exchangeState == ExchangeState::RANGE_REPORT_EXPECTED && _reportedDevicesNumber >= _answeredDevicesNumber)
+							completeExchange();
 
 						// We can call our handler !
 						// we have finished our range computation. We send the corresponding handler
-						if (_handleNewRange != 0)
-						{
-							(*_handleNewRange)(myDistantDevice);
-						}
+						handleNewRange(myDistantDevice, curRange, curRange, powers);
 					}
 					else
 					{
@@ -680,6 +1014,39 @@ void DW1000Ranging::handleReceived()
 	_portable.log_inf(DW_RANGING, "Received a frame....");
 }
 
+void DW1000Ranging::handleReceiveFailed()
+{
+	// the driver re-arms the receiver itself, we only keep count
+	_counters.receiveFailures++;
+}
+
+void DW1000Ranging::handleReceiveTimeout()
+{
+	// the receiver stays off, the loop decides what comes next
+	_receiveTimedOut = true;
+}
+
+void DW1000Ranging::handleNewRange(DW1000Device *myDistantDevice, float range, float rawRange, const FramePowers &powers)
+{
+	scoreRange(myDistantDevice, powers);
+	if (_antennaCalibrating)
+	{
+		// the delay errors show in the raw range, the temperature range correction is not one of them
+		uint16_t ownAddress = (uint16_t)_ownShortAddress[1] << 8 | _ownShortAddress[0];
+		_antennaCalibration.addRange(ownAddress, myDistantDevice->getShortAddress(), rawRange);
+	}
+	if (_rangeFilter.isEnabled())
+	{
+		float rate = 0;
+		if (!_rangeFilter.update(myDistantDevice->getIndex(), _portable.millis(), range, rate))
+			return;
+		myDistantDevice->setRangeRate(rate);
+	}
+	myDistantDevice->setRange(range);
+	if (_handleNewRange != 0)
+		(*_handleNewRange)(myDistantDevice);
+}
+
 void DW1000Ranging::noteActivity()
 {
 	// update activity timestamp, so that we do not reach "resetPeriod"
@@ -691,6 +1058,13 @@ void DW1000Ranging::resetInactive()
 	// if inactive
 	if (_portable.millis() - _lastActivity > _resetPeriod)
 	{
+		if (_radioState == RadioState::SLEEP || (_type == BoardType::TAG && _rangingMode == RangingMode::TDOA_BLINK))
+		{
+			// silence is expected while the radio sleeps, and by a TDoA tag that listens for nothing
+			noteActivity();
+			return;
+		}
+
 		// VISHWA: reset to receive mode on reset_period
 		// will this help? only anchor was getting reset
 		// we shall do that for tag also?
@@ -700,21 +1074,320 @@ void DW1000Ranging::resetInactive()
 			// receiver();
 		}
 
+		_counters.watchdogResets++;
 		receiver();
 		noteActivity();
 	}
 }
 
+/* ###########################################################################
+ * #### TAG exchange state machine ###########################################
+ * ########################################################################### */
+
+void DW1000Ranging::startExchange(ExchangeState state, uint32_t timeout)
+{
+	if (state == ExchangeState::POLL_ACK_EXPECTED && _exchangeState != ExchangeState::POLL_ACK_EXPECTED)
+		_exchangeRetries = 0; // a new round, not a retry
+	_exchangeState = state;
+	_timers.arm(exchangeTimerId, timeout + 1);
+}
+
+void DW1000Ranging::finishPollAckPhase()
+{
+	if (_rangeReportMode == RangeReportMode::UNICAST && _reportedDevicesNumber < _answeredDevicesNumber)
+	{
+		// the reports come back in the reply slots of the devices of our last RANGE
+		startExchange(ExchangeState::RANGE_REPORT_EXPECTED, (DEFAULT_REPLY_DELAY_TIME + getReplyTimeOfIndex(_answeredDevicesNumber - 1)) / 1000 + exchangeTimeoutMargin);
+		return;
+	}
+	completeExchange();
+}
+
+void DW1000Ranging::completeExchange()
+{
+	_timers.cancel(exchangeTimerId);
+	_exchangeState = ExchangeState::IDLE;
+	_exchangeRetries = 0;
+	_failedExchanges = 0;
+	_warmRestartUnconfirmed = false;
+	if (_boundedReceive)
+	{
+		// back to the unbounded receiver between rounds (RANGING_INIT, aggregated reports)
+		pDW1000.setFrameWaitTimeout(0);
+		if (_powerMode == PowerMode::ALWAYS_ON)
+			receiver();
+	}
+	scheduleSleep(0);
+}
+
+void DW1000Ranging::handleExchangeTimeout()
+{
+	if (_exchangeState == ExchangeState::IDLE)
+		return;
+	if (_sentAck || _receivedAck)
+	{
+		// a frame is waiting to be handled, it may be the answer we are waiting for
+		_timers.arm(exchangeTimerId, 1);
+		return;
+	}
+
+	if (_exchangeState == ExchangeState::RANGE_REPORT_EXPECTED)
+	{
+		// the ranges were computed by the anchors anyway, the next round will do
+		_counters.rangeReportTimeouts++;
+		completeExchange();
+		return;
+	}
+
+	if (_answeredDevicesNumber > 0)
+	{
+		// some anchors answered, the round is good enough
+		finishPollAckPhase();
+		return;
+	}
+
+	_counters.pollAckTimeouts++;
+	_portable.log_inf(DW_RANGING, "No POLL_ACK before the deadline (retry %d)", _exchangeRetries);
+	if (_requestTimeoutExtention != 0)
+		(*_requestTimeoutExtention)();
+
+	if (_exchangeRetries < maxPollRetries)
+	{
+		// maybe we were deaf, restart the receiver and ask again
+		recoverReceiver();
+		_exchangeRetries++;
+		_counters.pollRetries++;
+		transmitPoll();
+		return;
+	}
+
+	_counters.exchangesFailed++;
+	_exchangeState = ExchangeState::IDLE;
+	if (++_failedExchanges >= maxFailedExchanges)
+	{
+		// the cheap recovery did not help, the chip may be in a bad state
+		_portable.log_war(DW_RANGING, "%d rounds without answer, reset DWM", _failedExchanges);
+		_failedExchanges = 0;
+		reinitChip();
+	}
+	else
+	{
+		if (_boundedReceive)
+			pDW1000.setFrameWaitTimeout(0);
+		recoverReceiver();
+	}
+	scheduleSleep(0);
+}
+
+void DW1000Ranging::recoverReceiver()
+{
+	_counters.rxRearms++;
+	receiver();
+}
+
+void DW1000Ranging::reinitChip()
+{
+	uint32_t start = _portable.millis();
+	// try keeping the chip state first, unless that already did not help
+	if (!_warmRestartUnconfirmed && pDW1000.warmRestart())
+	{
+		_warmRestartUnconfirmed = true;
+		_counters.warmRestarts++;
+		_counters.lastRecoveryMs = _portable.millis() - start;
+		_portable.log_inf(DW_RANGING, "DWM warm restart, %d registers restored", pDW1000.getRestoredRegisters());
+		applyListenMode();
+		receiver();
+		return;
+	}
+	_warmRestartUnconfirmed = false;
+	_counters.chipResets++;
+	pDW1000.select();
+	pDW1000.setEUI(_ownLongAddress);
+	configureNetwork((uint16_t)_ownShortAddress[1] << 8 | _ownShortAddress[0], 0xDECA, _profile);
+	if (_highPower)
+		pDW1000.high_power_init();
+	// the configuration above reverts the listen mode
+	applyListenMode();
+	receiver();
+	_counters.lastRecoveryMs = _portable.millis() - start;
+}
+
+/* ###########################################################################
+ * #### Radio power management ###############################################
+ * ########################################################################### */
+
+void DW1000Ranging::setListenMode(ListenMode mode)
+{
+	if (!checkStarted("listen mode"))
+		return;
+	_listenMode = mode;
+	applyListenMode();
+	receiver();
+}
+
+void DW1000Ranging::applyListenMode()
+{
+	if (_type == BoardType::TAG)
+	{
+		// a sniffing anchor only catches preambles longer than its sniff period
+		uint8_t prealen = _profile.getPreambleLength();
+		if (_listenMode == ListenMode::SNIFF && DW1000::getPreambleSymbols(prealen) < DW1000::getPreambleSymbols(sniffPreambleLength))
+			prealen = sniffPreambleLength;
+		pDW1000.setTransmitPreambleLength(prealen);
+		return;
+	}
+
+	// ANCHOR: sniff only while no exchange is in flight, RANGE frames come back in full RX
+	bool sniff = _listenMode == ListenMode::SNIFF;
+	for (uint8_t i = 0; sniff && i < MAX_SESSIONS; i++)
+	{
+		if (_sessions[i].state != SessionState::FREE)
+			sniff = false;
+	}
+	if (sniff != pDW1000.isSniffMode())
+		pDW1000.setSniffMode(sniff, sniffOnTime, sniffOffTime);
+}
+
+void DW1000Ranging::setPowerMode(PowerMode mode)
+{
+	if (!checkStarted("power mode"))
+		return;
+	if (_type != BoardType::TAG)
+	{
+		_portable.log_war(DW_RANGING, "Power modes are available to TAGs only");
+		return;
+	}
+	_powerMode = mode;
+	if (mode == PowerMode::DUTY_CYCLED)
+	{
+		scheduleSleep(0);
+		return;
+	}
+	_timers.cancel(wakeupTimerId);
+	_timers.cancel(sleepTimerId);
+	if (_radioState == RadioState::SLEEP)
+	{
+		wakeRadio();
+		receiver();
+	}
+}
+
+void DW1000Ranging::scheduleSleep(uint32_t delay)
+{
+	if (_type == BoardType::TAG && _powerMode == PowerMode::DUTY_CYCLED)
+		_timers.arm(sleepTimerId, delay);
+}
+
+void DW1000Ranging::sleepRadio()
+{
+	if (_radioState == RadioState::SLEEP)
+		return;
+	_timers.cancel(sleepTimerId);
+	pDW1000.deepSleep();
+	setRadioState(RadioState::SLEEP);
+}
+
+void DW1000Ranging::wakeRadio()
+{
+	if (_radioState != RadioState::SLEEP)
+		return;
+	pDW1000.spiWakeup();
+	setRadioState(RadioState::IDLE);
+	if (!pDW1000.restoreFromSleep())
+	{
+		_portable.log_war(DW_RANGING, "DWM did not wake up, reset DWM");
+		reinitChip();
+	}
+}
+
+void DW1000Ranging::setRadioState(RadioState state)
+{
+	uint32_t currentTime = _portable.micros();
+	// time booked ahead is not counted again, the new state starts at its end
+	if ((int32_t)(currentTime - _radioStateSince) > 0)
+	{
+		addRadioTime(_radioState, currentTime - _radioStateSince);
+		_radioStateSince = currentTime;
+	}
+	_radioState = state;
+}
+
+void DW1000Ranging::bookRadioTime(RadioState state, uint32_t us)
+{
+	// known ahead, e.g. the wait for a delayed start or a frame on air
+	addRadioTime(state, us);
+	_radioStateSince += us;
+}
+
+void DW1000Ranging::addRadioTime(RadioState state, uint32_t us)
+{
+	if (state == RadioState::SLEEP)
+		_roundEnergy.sleepUs += us;
+	else if (state == RadioState::IDLE)
+		_roundEnergy.idleUs += us;
+	else if (state == RadioState::TX)
+		_roundEnergy.txUs += us;
+	else
+		_roundEnergy.rxUs += us;
+}
+
+void DW1000Ranging::noteTransmit(uint16_t length, uint32_t delayUs)
+{
+	// idle until a delayed frame starts, then on air, then listening only if the receiver comes back on
+	setRadioState(RadioState::IDLE);
+	bookRadioTime(RadioState::IDLE, delayUs);
+	bookRadioTime(RadioState::TX, pDW1000.getFrameDurationUs(length));
+	setRadioState(pDW1000.isReceiverEnabled() ? RadioState::RX : RadioState::IDLE);
+}
+
+void DW1000Ranging::closeEnergyRound()
+{
+	// account for the time spent in the current state so far
+	setRadioState(_radioState);
+	// mA * V * us = nJ
+	_roundEnergy.energyUj = SUPPLY_VOLTAGE / 1000.0f * (CURRENT_SLEEP_MA * _roundEnergy.sleepUs + CURRENT_IDLE_MA * _roundEnergy.idleUs + CURRENT_RX_MA * _roundEnergy.rxUs + CURRENT_TX_MA * _roundEnergy.txUs);
+	_lastRoundEnergy = _roundEnergy;
+	memset(&_roundEnergy, 0, sizeof(_roundEnergy));
+	if (_handleRoundEnergy != 0)
+		(*_handleRoundEnergy)(&_lastRoundEnergy);
+}
+
 void DW1000Ranging::timerTick()
 {
+	if (_temperatureCorrection && (int32_t)(_portable.millis() - _temperatureDue) >= 0 && _radioState != RadioState::SLEEP &&
+		_exchangeState == ExchangeState::IDLE && !isPollAckScheduled())
+	{
+		// between the exchanges, the sampling briefly reconfigures the SAR
+		sampleTemperature();
+	}
+
+	if (_crystalRepeatPeriod != 0 && !_crystalCalibrating && (int32_t)(_portable.millis() - _crystalCalibrationDue) >= 0)
+	{
+		// the crystal drifts with the temperature, measure again
+		_crystalSamples = 0;
+		_crystalOffsetSum = 0;
+		_crystalCalibrating = true;
+	}
+
+	if (_type == BoardType::ANCHOR && _pendingReportsNumber > 0 && !isPollAckScheduled())
+	{
+		// one broadcast for all the tags served during the last period
+		transmitAggregatedRangeReport();
+	}
+
+	if (_type == BoardType::TAG && _rangingMode == RangingMode::TDOA_BLINK)
+	{
+		// no exchanges, the anchors only listen
+		transmitTdoaBlink();
+		return;
+	}
+
 	if (counterForBlink == 0)
 	{
 		if (_type == BoardType::TAG)
 		{
 			transmitBlink();
 		}
-		// check for inactive devices if we are a TAG or ANCHOR
-		checkForInactiveDevices();
 	}
 	else
 	{
@@ -743,17 +1416,18 @@ void DW1000Ranging::transmitInit()
 	pDW1000.setDefaults();
 }
 
-void DW1000Ranging::transmit(uint8_t datas[])
+void DW1000Ranging::transmit(uint8_t datas[], uint16_t length, uint32_t delayUs)
 {
-	pDW1000.setData(datas, LEN_DATA);
+	// delayUs: delayed start already programmed, for the energy bookkeeping only
+	pDW1000.setData(datas, length);
 	pDW1000.startTransmit();
+	noteTransmit(length, delayUs);
 }
 
 void DW1000Ranging::transmit(uint8_t datas[], DW1000Time time)
 {
 	pDW1000.setDelay(time);
-	pDW1000.setData(datas, LEN_DATA);
-	pDW1000.startTransmit();
+	transmit(datas, LEN_DATA, (uint32_t)time.getAsMicroSeconds());
 }
 
 void DW1000Ranging::transmitBlink()
@@ -770,11 +1444,27 @@ void DW1000Ranging::transmitBlink()
 		memcpy(sentData + BLINK_MAC_LEN + 1 + i * 2, _networkDevices[i].getByteShortAddress(), 2);
 	}
 	transmit(sentData);
+	// the anchors answer in random slots, listen for all of them
+	scheduleSleep(rangingInitListenTime);
 
 	uint8_t shortBroadcast[2] = {0xFF, 0xFF};
 	copyShortAddress(_lastSentToShortAddress, shortBroadcast);
 }
 
+void DW1000Ranging::transmitTdoaBlink()
+{
+	_timerDelay = _rangeInterval;
+
+	transmitInit();
+	// the bare header: frame control, sequence number and our address
+	_globalMac.generateBlinkFrame(sentData, _ownShortAddress);
+	// nothing to listen for, the receiver stays off once the frame is out
+	pDW1000.receivePermanently(false);
+	transmit(sentData, BLINK_MAC_LEN);
+	// back to sleep then
+	scheduleSleep(pDW1000.getFrameDurationUs(BLINK_MAC_LEN) / 1000 + 1);
+}
+
 void DW1000Ranging::transmitRangingInit(DW1000Device *myDistantDevice, uint16_t delay)
 {
 	transmitInit();
@@ -799,12 +1489,13 @@ void DW1000Ranging::transmitPoll()
 
 	uint8_t shortBroadcast[2] = {0xFF, 0xFF};
 	_globalMac.generateShortMACFrame(sentData, _ownShortAddress, shortBroadcast);
-	sentData[SHORT_MAC_LEN] = static_cast<uint8_t>(MessageType::POLL);
+	sentData[SHORT_MAC_LEN] = static_cast<uint8_t>(_rangingMode == RangingMode::SS_TWR ? MessageType::POLL_SS : MessageType::POLL);
 	// we enter the number of devices
 	sentData[SHORT_MAC_LEN + 1] = devicesCount;
 
 	// uint8_t freeSlots = pollAckTimeSlots - devicesCount;
 
+	uint16_t lastReplyTime = 0;
 	for (uint8_t i = 0; i < devicesCount; i++)
 	{
 		// each devices have a different reply delay time.
@@ -817,33 +1508,217 @@ void DW1000Ranging::transmitPoll()
 		uint16_t replyTime = _networkDevices[i].getReplyTime();
 		memcpy(sentData + SHORT_MAC_LEN + 2 + 2 + i * pollDeviceSize, &replyTime, 2);
 
-		_replyTimeOfLastPollAck = replyTime;
+		lastReplyTime = replyTime;
 	}
 
-	_timeOfLastPollSent = _portable.millis();
+	// the last anchor answers in the last slot
+	_polledDevicesNumber = devicesCount;
+	_answeredDevicesNumber = 0;
+	_reportedDevicesNumber = 0;
+	startExchange(ExchangeState::POLL_ACK_EXPECTED, lastReplyTime / 1000 + exchangeTimeoutMargin);
 
 	copyShortAddress(_lastSentToShortAddress, shortBroadcast);
 
+	if (_waitForResponse)
+	{
+		// the response delay counts from the end of our frame, the window start from its RMARKER
+		uint32_t frameTime = pDW1000.getFrameDurationUs(LEN_DATA);
+		uint32_t windowStart = getPollAckWindowStart();
+		pDW1000.receivePermanently(true);
+		pDW1000.setFrameWaitTimeout(_boundedReceive ? getPollAckWindowLength() : 0);
+		pDW1000.setResponseDelay(windowStart > frameTime ? windowStart - frameTime : 0);
+		pDW1000.waitForResponse(true);
+	}
 	transmit(sentData);
 }
 
-void DW1000Ranging::transmitPollAck(DW1000Device *myDistantDevice, uint16_t delay)
+uint32_t DW1000Ranging::getPollAckWindowStart()
+{
+	// the preamble of a POLL_ACK starts one frame time before its RMARKER, at the reply time after our POLL
+	uint32_t lead = pDW1000.getFrameDurationUs(LEN_DATA) + receiveWindowGuardUs;
+	uint32_t firstSlot = getReplyTimeOfIndex(0);
+	return firstSlot > lead ? firstSlot - lead : 0;
+}
+
+uint32_t DW1000Ranging::getPollAckWindowLength()
+{
+	uint32_t lastSlot = getReplyTimeOfIndex(_polledDevicesNumber > 0 ? _polledDevicesNumber - 1 : 0);
+	// up to the end of the last POLL_ACK, the timeout must not cut it
+	uint32_t windowUs = lastSlot + pDW1000.getFrameDurationUs(LEN_DATA) + receiveWindowGuardUs - getPollAckWindowStart();
+	return windowUs > 0xFFFF ? 0xFFFF : windowUs;
+}
+
+void DW1000Ranging::transmitPollAck(RangingSession *session, uint32_t leadUs)
 {
 	transmitInit();
-	_globalMac.generateShortMACFrame(sentData, _ownShortAddress, myDistantDevice->getByteShortAddress());
-	sentData[SHORT_MAC_LEN] = static_cast<uint8_t>(MessageType::POLL_ACK);
-	// delay the same amount as ranging tag
-	DW1000Time deltaTime = DW1000Time(delay, DW1000Time::MICROSECONDS);
-	transmit(sentData, deltaTime);
+	memcpy(sentData, session->ackFrame, sizeof(session->ackFrame));
+	// delayed TX at the slot the tag asked for, the future sent timestamp is known before the frame is written
+	session->timePollAckSent = pDW1000.setDelayedTime(session->timePollAckDue);
+	if (session->singleSided)
+	{
+		// single-sided: the ACK carries our timestamps
+		session->timePollReceived.getTimestamp(sentData + SHORT_MAC_LEN + 1);
+		session->timePollAckSent.getTimestamp(sentData + SHORT_MAC_LEN + 6);
+	}
+	copyShortAddress(_lastSentToShortAddress, session->tagAddress);
+	transmit(sentData, LEN_DATA, leadUs);
+	session->state = SessionState::ACK_SCHEDULED;
 }
 
-void DW1000Ranging::transmitRange()
+/* ###########################################################################
+ * #### ANCHOR TDoA listener #################################################
+ * ########################################################################### */
+
+void DW1000Ranging::receiveTdoaBlink()
 {
-	// Disable range send on timeout
-	_replyTimeOfLastPollAck = 0;
-	_timeOfLastPollSent = 0;
+	uint8_t tagAddr[2];
+	_globalMac.decodeBlinkFrame(receivedData, tagAddr);
+
+	TdoaRecord record;
+	record.tagAddress = (uint16_t)tagAddr[1] << 8 | tagAddr[0];
+	record.sequenceNumber = receivedData[1];
+	DW1000Time timeReceived;
+	pDW1000.getReceiveTimestamp(timeReceived);
+	record.rxTimestamp = timeReceived.getTimestamp();
+
+	noteActivity();
+	if (_handleTdoaRecord != 0)
+		(*_handleTdoaRecord)(&record);
+}
 
-	// _expectedMsgId = ENABLE_RANGE_REPORT ? MessageType::RANGE_REPORT : MessageType::POLL_ACK;
+/* ###########################################################################
+ * #### ANCHOR session table #################################################
+ * ########################################################################### */
+
+RangingSession *DW1000Ranging::openSession(uint8_t tagAddress[])
+{
+	RangingSession *freeSession = nullptr;
+	for (uint8_t i = 0; i < MAX_SESSIONS; i++)
+	{
+		if (_sessions[i].state == SessionState::FREE)
+		{
+			if (freeSession == nullptr)
+				freeSession = &_sessions[i];
+		}
+		else if (memcmp(_sessions[i].tagAddress, tagAddress, 2) == 0 && _sessions[i].state != SessionState::ACK_SCHEDULED)
+		{
+			// a new POLL from the same tag restarts its exchange
+			return &_sessions[i];
+		}
+	}
+	if (freeSession != nullptr)
+	{
+		copyShortAddress(freeSession->tagAddress, tagAddress);
+		// the POLL_ACK and RANGE of this exchange go through the receiver fully on
+		freeSession->state = SessionState::POLL_RECEIVED;
+		applyListenMode();
+	}
+	return freeSession;
+}
+
+RangingSession *DW1000Ranging::searchSession(uint8_t tagAddress[], SessionState state)
+{
+	for (uint8_t i = 0; i < MAX_SESSIONS; i++)
+	{
+		if (_sessions[i].state == state && memcmp(_sessions[i].tagAddress, tagAddress, 2) == 0)
+			return &_sessions[i];
+	}
+	return nullptr;
+}
+
+void DW1000Ranging::closeSession(RangingSession *session)
+{
+	session->state = SessionState::FREE;
+	_timers.cancel(sessionTimerId + (session - _sessions));
+	bool sniffing = pDW1000.isSniffMode();
+	applyListenMode();
+	// sniffing starts with the next RX enable, and the receiver was re-armed in full RX after the last frame
+	if (!sniffing && pDW1000.isSniffMode() && _radioState == RadioState::RX)
+	{
+		pDW1000.idle();
+		receiver();
+	}
+}
+
+void DW1000Ranging::armSessionTimer(RangingSession *session, uint32_t timeout)
+{
+	_timers.arm(sessionTimerId + (session - _sessions), timeout + 1);
+}
+
+bool DW1000Ranging::isPollAckScheduled()
+{
+	for (uint8_t i = 0; i < MAX_SESSIONS; i++)
+	{
+		if (_sessions[i].state == SessionState::ACK_SCHEDULED)
+			return true;
+	}
+	return false;
+}
+
+void DW1000Ranging::scheduleNextPollAck()
+{
+	// the chip holds a single delayed TX, a new one would cancel it
+	if (isPollAckScheduled())
+		return;
+
+	DW1000Time now;
+	pDW1000.getSystemTimestamp(now);
+	const int64_t minLead = DW1000Time(minPollAckLeadUs, DW1000Time::MICROSECONDS).getTimestamp();
+
+	while (true)
+	{
+		// earliest POLL_ACK still waiting for the radio
+		RangingSession *next = nullptr;
+		int64_t nextLead = 0;
+		for (uint8_t i = 0; i < MAX_SESSIONS; i++)
+		{
+			if (_sessions[i].state != SessionState::POLL_RECEIVED)
+				continue;
+			int64_t lead = (_sessions[i].timePollAckDue - now).wrap().getTimestamp();
+			if (next == nullptr || lead < nextLead)
+			{
+				next = &_sessions[i];
+				nextLead = lead;
+			}
+		}
+		if (next == nullptr)
+			return;
+
+		// a due time in the past wraps around to a huge lead
+		if (nextLead < minLead || nextLead > DW1000Time::TIME_OVERFLOW / 2)
+		{
+			_portable.log_war(DW_RANGING, "POLL_ACK slot to %x:%x missed", next->tagAddress[0], next->tagAddress[1]);
+			_counters.missedAckSlots++;
+			closeSession(next);
+			continue;
+		}
+
+		transmitPollAck(next, (uint32_t)DW1000Time(nextLead).getAsMicroSeconds());
+		return;
+	}
+}
+
+void DW1000Ranging::handleSessionTimeout(uint8_t index)
+{
+	RangingSession *session = &_sessions[index];
+	if (session->state == SessionState::FREE)
+		return;
+
+	_portable.log_dbg(DW_RANGING, "Session with %x:%x timed out", session->tagAddress[0], session->tagAddress[1]);
+	bool ackDropped = session->state == SessionState::ACK_SCHEDULED;
+	_counters.sessionTimeouts++;
+	closeSession(session);
+	if (ackDropped)
+	{
+		// the delayed POLL_ACK never left, give the radio back to the receiver
+		recoverReceiver();
+		scheduleNextPollAck();
+	}
+}
+
+void DW1000Ranging::transmitRange()
+{
+	// _expectedMsgId = _rangeReportMode == RangeReportMode::UNICAST ? MessageType::RANGE_REPORT : MessageType::POLL_ACK;
 
 	constexpr uint8_t devicePerTransmit = 6;
 
@@ -862,6 +1737,7 @@ void DW1000Ranging::transmitRange()
 		_portable.log_inf(DW_RANGING, "Not transmitting range as no anchor has sent any POLL_ACK yet");
 		return;
 	}
+
 	// we need to set our timerDelay:
 	_timerDelay = _rangeInterval + (uint16_t)(devicesCount * 3 * DEFAULT_REPLY_DELAY_TIME / 1000);
 
@@ -879,7 +1755,7 @@ void DW1000Ranging::transmitRange()
 
 	for (uint8_t i = 0; i < devicesCount; i++)
 	{
-		if (ENABLE_RANGE_REPORT)
+		if (_rangeReportMode == RangeReportMode::UNICAST)
 			// each devices have a different reply delay time.
 			devices[i]->setReplyTime(getReplyTimeOfIndex(i));
 
@@ -897,24 +1773,69 @@ void DW1000Ranging::transmitRange()
 		memcpy(sentData + SHORT_MAC_LEN + 14 + rangeDeviceSize * i, &_payload, 4);
 	}
 
-	transmit(sentData);
+	transmit(sentData, LEN_DATA, DEFAULT_REPLY_DELAY_TIME);
 }
 
-void DW1000Ranging::transmitRangeReport(DW1000Device *myDistantDevice, uint16_t delay)
+void DW1000Ranging::transmitRangeReport(DW1000Device *myDistantDevice, float range, uint16_t delay)
 {
 	transmitInit();
 	_globalMac.generateShortMACFrame(sentData, _ownShortAddress, myDistantDevice->getByteShortAddress());
 	sentData[SHORT_MAC_LEN] = static_cast<uint8_t>(MessageType::RANGE_REPORT);
 	// write final ranging result
-	float curRange = myDistantDevice->getRange();
 	float curRXPower = myDistantDevice->getRXPower();
 	// We add the Range and then the RXPower
-	memcpy(sentData + 1 + SHORT_MAC_LEN, &curRange, 4);
+	memcpy(sentData + 1 + SHORT_MAC_LEN, &range, 4);
 	memcpy(sentData + 5 + SHORT_MAC_LEN, &curRXPower, 4);
 	copyShortAddress(_lastSentToShortAddress, myDistantDevice->getByteShortAddress());
 	transmit(sentData, DW1000Time(delay, DW1000Time::MICROSECONDS));
 }
 
+void DW1000Ranging::queueRangeReport(DW1000Device *myDistantDevice, float range)
+{
+	// a tag served twice in the same period only gets its latest range
+	uint8_t slot = _pendingReportsNumber;
+	for (uint8_t i = 0; i < _pendingReportsNumber; i++)
+	{
+		if (memcmp(_pendingReports + i * rangeReportEntrySize, myDistantDevice->getByteShortAddress(), 2) == 0)
+		{
+			slot = i;
+			break;
+		}
+	}
+	if (slot == maxAggregatedReports)
+	{
+		_portable.log_war(DW_RANGING, "Aggregated range report full, dropping range of %x", myDistantDevice->getShortAddress());
+		return;
+	}
+
+	uint8_t *report = _pendingReports + slot * rangeReportEntrySize;
+	float curRXPower = myDistantDevice->getRXPower();
+	memcpy(report, myDistantDevice->getByteShortAddress(), 2);
+	memcpy(report + 2, &range, 4);
+	memcpy(report + 6, &curRXPower, 4);
+	if (slot == _pendingReportsNumber)
+		_pendingReportsNumber++;
+}
+
+void DW1000Ranging::transmitAggregatedRangeReport()
+{
+	transmitInit();
+	uint8_t shortBroadcast[2] = {0xFF, 0xFF};
+	_globalMac.generateShortMACFrame(sentData, _ownShortAddress, shortBroadcast);
+	sentData[SHORT_MAC_LEN] = static_cast<uint8_t>(MessageType::RANGE_REPORT_AGGREGATED);
+	sentData[SHORT_MAC_LEN + 1] = _pendingReportsNumber;
+	memcpy(sentData + SHORT_MAC_LEN + 2, _pendingReports, _pendingReportsNumber * rangeReportEntrySize);
+	_pendingReportsNumber = 0;
+
+	copyShortAddress(_lastSentToShortAddress, shortBroadcast);
+
+	// random slot, so that anchors sharing the period do not collide
+	constexpr short slotQty = 7;
+	constexpr uint16_t slotDuration = 2.5 * DEFAULT_REPLY_DELAY_TIME;
+	uint16_t delay = slotDuration * (_portable.random(0, slotQty) + 1);
+	transmit(sentData, DW1000Time(delay, DW1000Time::MICROSECONDS));
+}
+
 void DW1000Ranging::transmitRangeFailed(DW1000Device *myDistantDevice)
 {
 	transmitInit();
@@ -932,6 +1853,31 @@ void DW1000Ranging::receiver()
 	// so we don't need to restart the receiver manually
 	pDW1000.receivePermanently(true);
 	pDW1000.startReceive();
+	setRadioState(RadioState::RX);
+}
+
+void DW1000Ranging::openReceiveWindow(const DW1000Time &start, uint32_t windowUs)
+{
+	pDW1000.newReceive();
+	pDW1000.setDefaults();
+	// re-armed after every frame of the window, for what is left of it
+	pDW1000.receivePermanently(true);
+	pDW1000.setFrameWaitTimeout(windowUs > 0xFFFF ? 0xFFFF : windowUs);
+	pDW1000.setReceiveWindowEnd(start + DW1000Time((int32_t)windowUs, DW1000Time::MICROSECONDS));
+
+	DW1000Time now;
+	pDW1000.getSystemTimestamp(now);
+	int64_t lead = (start - now).wrap().getTimestamp();
+	// too close (or already past, wrapping to a huge lead) to be programmed: open right away
+	bool delayed = lead > DW1000Time(receiveWindowGuardUs, DW1000Time::MICROSECONDS).getTimestamp() && lead < DW1000Time::TIME_OVERFLOW / 2;
+	if (delayed)
+		pDW1000.setDelayedTime(start);
+	pDW1000.startReceive();
+	// idle until the window opens
+	setRadioState(RadioState::IDLE);
+	if (delayed)
+		bookRadioTime(RadioState::IDLE, (uint32_t)DW1000Time(lead).getAsMicroSeconds());
+	setRadioState(RadioState::RX);
 }
 
 uint16_t DW1000Ranging::getReplyTimeOfIndex(int i)
@@ -939,6 +1885,102 @@ uint16_t DW1000Ranging::getReplyTimeOfIndex(int i)
 	return (2 * i + 1) * DEFAULT_REPLY_DELAY_TIME;
 }
 
+/* ###########################################################################
+ * #### Positioning ##########################################################
+ * ########################################################################### */
+
+bool DW1000Ranging::computePosition(PositionFix &fix)
+{
+	uint16_t addresses[MAX_DEVICES];
+	float ranges[MAX_DEVICES];
+	float weights[MAX_DEVICES];
+	float predicted[RANGE_FILTER_CHANNELS];
+	bool extrapolate = _rangeFilter.getConfig().accelerationNoise > 0;
+	if (extrapolate)
+		_rangeFilter.predict(_portable.millis(), predicted);
+
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < _networkDevicesNumber; i++)
+	{
+		DW1000Device *device = &_networkDevices[i];
+		if (device->getRange() <= 0)
+			continue; // no range yet
+		addresses[n] = device->getShortAddress();
+		// a channel the filter has not started yet extrapolates to 0
+		ranges[n] = extrapolate && predicted[i] > 0 ? predicted[i] : device->getRange();
+		weights[n] = device->getRangeScore() > minPositionWeight ? device->getRangeScore() : minPositionWeight;
+		n++;
+	}
+	return _position.solve(addresses, ranges, weights, n, fix);
+}
+
+/* ###########################################################################
+ * #### Antenna delay calibration ############################################
+ * ########################################################################### */
+
+void DW1000Ranging::startAntennaCalibration(uint16_t samplesPerPair)
+{
+	_calibrationSamples = samplesPerPair;
+	// a restart collects from scratch
+	_antennaCalibration.clearRanges();
+	_antennaCalibrating = true;
+}
+
+bool DW1000Ranging::finishAntennaCalibration()
+{
+	_antennaCalibrating = false;
+	if (!_antennaCalibration.solve())
+	{
+		_portable.log_war(DW_RANGING, "antenna calibration: distances do not determine every node");
+		return false;
+	}
+	uint16_t ownAddress = (uint16_t)_ownShortAddress[1] << 8 | _ownShortAddress[0];
+	int16_t correction;
+	if (_antennaCalibration.getCorrection(ownAddress, correction))
+	{
+		setAntennaDelay(getAntennaDelay() + correction);
+	}
+	_portable.log_inf(DW_RANGING, "antenna calibration: delay %d, residual %.3f m", getAntennaDelay(), _antennaCalibration.getResidual());
+	return true;
+}
+
+/* ###########################################################################
+ * #### Crystal trim #########################################################
+ * ########################################################################### */
+
+void DW1000Ranging::startCrystalCalibration(uint16_t referenceAddress, uint8_t frames, uint32_t repeatPeriod)
+{
+	_crystalReference = referenceAddress;
+	_crystalFrames = frames > 0 ? frames : 1;
+	_crystalSamples = 0;
+	_crystalOffsetSum = 0;
+	_crystalRepeatPeriod = repeatPeriod;
+	_crystalCalibrating = true;
+}
+
+void DW1000Ranging::sampleCrystalOffset(uint8_t address[])
+{
+	if (!_crystalCalibrating || ((uint16_t)address[1] << 8 | address[0]) != _crystalReference)
+		return;
+
+	_crystalOffsetSum += pDW1000.getClockOffset();
+	if (++_crystalSamples < _crystalFrames)
+		return;
+
+	// the reference runs faster by _crystalOffset ppm, a lower trim speeds our clock up
+	_crystalOffset = _crystalOffsetSum / _crystalSamples;
+	int16_t trim = pDW1000.getCrystalTrim() - (int16_t)lroundf(_crystalOffset / DW1000::CRYSTAL_TRIM_PPM);
+	if (trim < 0)
+		trim = 0;
+	else if (trim > DW1000::CRYSTAL_TRIM_MAX)
+		trim = DW1000::CRYSTAL_TRIM_MAX;
+	pDW1000.setCrystalTrim(trim);
+	_portable.log_inf(DW_RANGING, "crystal offset %.2f ppm, trim %d", _crystalOffset, trim);
+
+	_crystalCalibrating = false;
+	_crystalCalibrationDue = _portable.millis() + _crystalRepeatPeriod;
+}
+
 /* ###########################################################################
  * #### Methods for range computation and corrections  #######################
  * ########################################################################### */
@@ -969,3 +2011,99 @@ void DW1000Ranging::computeRangeAsymmetric(DW1000Device *myDistantDevice, DW1000
 	_portable.log_vrb(DW_RANGING, LOG_DW1000_MSG, "reply2 %lld", (long)reply2.getTimestamp());
 	*/
 }
+
+void DW1000Ranging::computeRangeSingleSided(DW1000Device *myDistantDevice, DW1000Time *myTOF)
+{
+	// single-sided two-way ranging, the responder reply time is measured with its own clock
+	DW1000Time round = (myDistantDevice->timePollAckReceived - myDistantDevice->timePollSent).wrap();
+	DW1000Time reply = (myDistantDevice->timePollAckSent - myDistantDevice->timePollReceived).wrap();
+
+	// scale the reply time into our clock domain: reply * (1 - offset)
+	// the correction term is small, so the float multiplication does not hurt accuracy
+	DW1000Time correction = reply * (myDistantDevice->getClockOffset() * 1e-6f);
+
+	myTOF->setTimestamp((round - reply + correction).getTimestamp() / 2);
+}
+
+/*
+ * Cheap line of sight estimate from the values read with every frame anyway: energy arriving after
+ * the first path (RX minus FP power) grows when the direct path is blocked, and a first path barely
+ * above the noise gives an unreliable leading edge.
+ */
+void DW1000Ranging::scoreRange(DW1000Device *myDistantDevice, const FramePowers &powers)
+{
+	// both powers of the same frame at the same receiver, for a report the one that just came in
+	float powerDifference = powers.rxPower - powers.fpPower;
+	float losScore = (nlosPowerDifference - powerDifference) / (nlosPowerDifference - losPowerDifference);
+	float firstPathScore = (powers.quality - minFirstPathRatio) / (goodFirstPathRatio - minFirstPathRatio);
+	losScore = losScore < 0 ? 0 : (losScore > 1 ? 1 : losScore);
+	firstPathScore = firstPathScore < 0 ? 0 : (firstPathScore > 1 ? 1 : firstPathScore);
+	myDistantDevice->setRangeScore(losScore * firstPathScore, powerDifference > nlosPowerDifference);
+}
+
+FramePowers DW1000Ranging::readFramePowers()
+{
+	return {pDW1000.getReceivePower(), pDW1000.getFirstPathPower(), pDW1000.getReceiveQuality()};
+}
+
+float DW1000Ranging::correctRange(float range)
+{
+	if (!_temperatureCorrection)
+		return range;
+	return range - _rangeCoefficient * (_temperature - _referenceTemperature);
+}
+
+/* ###########################################################################
+ * #### Temperature correction ###############################################
+ * ########################################################################### */
+
+void DW1000Ranging::setAntennaDelay(uint16_t value)
+{
+	if (!checkStarted("antenna delay"))
+		return;
+	_baseAntennaDelay = value;
+	applyAntennaDelay();
+}
+
+uint16_t DW1000Ranging::getAntennaDelay()
+{
+	return _temperatureCorrection ? _baseAntennaDelay : pDW1000.getAntennaDelay();
+}
+
+void DW1000Ranging::setTemperatureCorrection(float delayCoefficient, float rangeCoefficient, float referenceTemperature, uint32_t samplePeriod)
+{
+	if (!checkStarted("temperature correction"))
+		return;
+	if (!_temperatureCorrection)
+		_baseAntennaDelay = pDW1000.getAntennaDelay();
+	_delayCoefficient = delayCoefficient;
+	_rangeCoefficient = rangeCoefficient;
+	_referenceTemperature = referenceTemperature;
+	_temperaturePeriod = samplePeriod;
+	_temperatureCorrection = true;
+	sampleTemperature();
+}
+
+void DW1000Ranging::disableTemperatureCorrection()
+{
+	if (!_temperatureCorrection)
+		return;
+	_temperatureCorrection = false;
+	applyAntennaDelay();
+}
+
+void DW1000Ranging::sampleTemperature()
+{
+	// the SAR readings are converted with the OTP references cached at bring-up, no OTP access
+	pDW1000.getTempAndVbat(_temperature, _voltage);
+	_temperatureDue = _portable.millis() + _temperaturePeriod;
+	applyAntennaDelay();
+}
+
+void DW1000Ranging::applyAntennaDelay()
+{
+	float drift = _temperatureCorrection ? _delayCoefficient * (_temperature - _referenceTemperature) : 0;
+	uint16_t delay = _baseAntennaDelay + (int16_t)lroundf(drift);
+	if (delay != pDW1000.getAntennaDelay())
+		pDW1000.setAntennaDelay(delay);
+}
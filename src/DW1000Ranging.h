@@ -4,6 +4,10 @@
 #include "DW1000Time.h"
 #include "DW1000Device.h"
 #include "DW1000Mac.h"
+#include "DW1000TimerWheel.h"
+#include "DW1000AntennaCalibration.h"
+#include "DW1000RangeFilter.h"
+#include "DW1000Position.h"
 
 // messages used in the ranging protocol
 enum class MessageType : uint8_t
@@ -14,6 +18,9 @@ enum class MessageType : uint8_t
 	RANGE_REPORT = 3,
 	BLINK = 4,
 	RANGING_INIT = 5,
+	POLL_SS = 6,
+	POLL_ACK_SS = 7,
+	RANGE_REPORT_AGGREGATED = 8,
 	TYPE_ERROR = 254,
 	RANGE_FAILED = 255,
 };
@@ -23,6 +30,12 @@ enum class MessageType : uint8_t
 // Max devices we put in the networkDevices array ! Each DW1000Device is 74 Bytes in SRAM memory for now.
 #define MAX_DEVICES 12
 
+static_assert(MAX_DEVICES <= RANGE_FILTER_CHANNELS, "one range filter channel per device");
+static_assert(MAX_DEVICES <= MAX_POSITION_ANCHORS, "one position anchor per device");
+
+// Max ranging exchanges an ANCHOR keeps in flight at the same time (one per tag)
+#define MAX_SESSIONS 4
+
 // One blink every x polls
 #define BLINK_INTERVAL 5
 
@@ -44,18 +57,145 @@ enum class BoardType : uint8_t
 	ANCHOR = 1,
 };
 
+// ranging scheme used by a tag
+enum class RangingMode : uint8_t
+{
+	DS_TWR_ASYMMETRIC = 0, // POLL, POLL_ACK, RANGE (and optional RANGE_REPORT)
+	SS_TWR = 1,			   // POLL_SS, POLL_ACK_SS with clock offset correction
+	TDOA_BLINK = 2,		   // bare BLINK every range interval, timestamped by TDoA listener anchors
+};
+
+// one BLINK timestamped by a TDoA listener anchor, synchronising the anchor clocks is up to the application
+struct TdoaRecord
+{
+	uint16_t tagAddress;
+	uint8_t sequenceNumber;
+	// chip time of the reception, 40 bit
+	int64_t rxTimestamp;
+};
+
+// state of an exchange on the ANCHOR side
+enum class SessionState : uint8_t
+{
+	FREE = 0,
+	POLL_RECEIVED = 1,	// POLL_ACK waiting for the radio
+	ACK_SCHEDULED = 2,	// delayed POLL_ACK programmed in the chip
+	RANGE_EXPECTED = 3, // POLL_ACK sent, waiting for the RANGE of the tag
+};
+
+// one in-flight exchange between the ANCHOR and a tag
+struct RangingSession
+{
+	SessionState state;
+	uint8_t tagAddress[2];
+	bool singleSided;
+	// absolute chip time at which the POLL_ACK has to leave
+	DW1000Time timePollAckDue;
+	DW1000Time timePollReceived;
+	DW1000Time timePollAckSent;
+	// POLL_ACK frame, built when the POLL is received
+	uint8_t ackFrame[SHORT_MAC_LEN + 1 + 2 * LEN_STAMP];
+};
+
+// state of the current exchange on the TAG side
+enum class ExchangeState : uint8_t
+{
+	IDLE = 0,
+	POLL_ACK_EXPECTED = 1,	   // POLL sent, anchors answer in their reply slots
+	RANGE_REPORT_EXPECTED = 2, // RANGE sent, anchors answer with a unicast RANGE_REPORT
+};
+
+// per-cause failure and recovery counters
+struct RangingCounters
+{
+	uint32_t pollAckTimeouts;	  // no POLL_ACK at all before the deadline
+	uint32_t rangeReportTimeouts; // RANGE_REPORT missing before the deadline
+	uint32_t pollRetries;		  // POLL sent again after a timeout
+	uint32_t exchangesFailed;	  // retries exhausted
+	uint32_t sessionTimeouts;	  // ANCHOR session expired
+	uint32_t missedAckSlots;	  // ANCHOR too late for a POLL_ACK slot
+	uint32_t receiveFailures;	  // frames dropped by the receiver (CRC, PHR, LDE ...)
+	uint32_t receiveTimeouts;	  // TAG receive window closed without the expected answers
+	uint32_t rxRearms;			  // cheap recovery: receiver restarted
+	uint32_t warmRestarts;		  // chip kept its state, only the differing registers restored
+	uint32_t chipResets;		  // expensive recovery: chip reset and reconfigured
+	uint32_t lastRecoveryMs;	  // duration of the last warm restart (well below 1 ms) or chip reset
+	uint32_t watchdogResets;	  // no activity at all for the reset period
+};
+
 // default timer delay
 #define DEFAULT_RANGE_INTERVAL 500
 
-#define ENABLE_RANGE_REPORT false
+// temperature and voltage sampling period for the temperature correction, in ms
+#define DEFAULT_TEMPERATURE_PERIOD 10000
+
+// typical DW1000 supply currents in mA (channel 5) and supply voltage, for the energy estimates
+#define CURRENT_SLEEP_MA 0.00005f
+#define CURRENT_IDLE_MA 13.0f
+#define CURRENT_RX_MA 118.0f
+#define CURRENT_TX_MA 83.0f
+#define SUPPLY_VOLTAGE 3.3f
+
+// how a TAG powers the radio between ranging rounds
+enum class PowerMode : uint8_t
+{
+	ALWAYS_ON = 0,	 // receiver permanently on
+	DUTY_CYCLED = 1, // deep sleep between rounds, receiver on only while answers are expected
+};
+
+// how an ANCHOR listens while no exchange is in flight, TAGs have to match it
+enum class ListenMode : uint8_t
+{
+	CONTINUOUS = 0, // receiver fully on
+	SNIFF = 1,		// ANCHOR: preamble sniffing while idle, TAG: preambles long enough to be sniffed
+};
+
+// radio state, for the energy bookkeeping
+enum class RadioState : uint8_t
+{
+	SLEEP = 0,
+	IDLE = 1,
+	RX = 2,
+	TX = 3,
+};
+
+// time spent in each radio state during one ranging round, and the resulting energy
+struct RadioEnergy
+{
+	uint32_t sleepUs;
+	uint32_t idleUs;
+	uint32_t rxUs;
+	uint32_t txUs; // air time of the frames sent
+	float energyUj;
+};
+
+// receive powers (dBm) and first path quality of one frame, read once per frame
+struct FramePowers
+{
+	float rxPower;
+	float fpPower;
+	float quality;
+};
+
+// how an anchor delivers its computed ranges back to the tags
+enum class RangeReportMode : uint8_t
+{
+	NONE = 0,		// ranges stay on the anchor
+	UNICAST = 1,	// one RANGE_REPORT per tag, right after its RANGE
+	AGGREGATED = 2, // one broadcast RANGE_REPORT_AGGREGATED per timer period for all served tags
+};
 
 class DW1000Ranging
 {
 public:
-	DW1000Ranging(PortableCode &_port) : _portable(_port), pDW1000(_port) {}
-	// Initialization
+	DW1000Ranging(PortableCode &_port) : _portable(_port), pDW1000(_port), _timers(_timerNodes, timerCount), _profile(PROFILE_LONGDATA_RANGE_LOWPOWER) {}
+	// Initialization, with a radio profile (see makeRadioProfile()) or a pre-defined mode on channel 5
+	void init(BoardType type, uint16_t shortAddress, const char *wifiMacAddress, bool high_power, const RadioProfile &profile, uint8_t myRST = DEFAULT_RST_PIN, uint8_t mySS = DEFAULT_SPI_SS_PIN, uint8_t myIRQ = DEFAULT_SPI_IRQ_PIN, float payload = 0.0);
+	void init(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, uint8_t myRST = DEFAULT_RST_PIN, uint8_t mySS = DEFAULT_SPI_SS_PIN, uint8_t myIRQ = DEFAULT_SPI_IRQ_PIN, float payload = 0.0);
 	void init(BoardType type, uint16_t shortAddress, const char *wifiMacAddress, bool high_power, const uint8_t mode[], uint8_t myRST = DEFAULT_RST_PIN, uint8_t mySS = DEFAULT_SPI_SS_PIN, uint8_t myIRQ = DEFAULT_SPI_IRQ_PIN, float payload = 0.0);
 	void init(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const uint8_t mode[], uint8_t myRST = DEFAULT_RST_PIN, uint8_t mySS = DEFAULT_SPI_SS_PIN, uint8_t myIRQ = DEFAULT_SPI_IRQ_PIN, float payload = 0.0);
+	// returns right away, the chip is brought up by loop() and handleReady called with the result
+	void initAsync(BoardType type, const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, void (*handleReady)(bool), uint8_t myRST = DEFAULT_RST_PIN, uint8_t mySS = DEFAULT_SPI_SS_PIN, uint8_t myIRQ = DEFAULT_SPI_IRQ_PIN, float payload = 0.0);
 
 	void loop();
 
@@ -67,13 +207,117 @@ public:
 	void attachInactiveDevice(void (*handleInactiveDevice)(DW1000Device *)) { _handleInactiveDevice = handleInactiveDevice; };
 	void attachRemovedDeviceMaxReached(void (*handleRemovedDeviceMaxReached)(DW1000Device *)) { _handleRemovedDeviceMaxReached = handleRemovedDeviceMaxReached; };
 	void attachTimeoutExtReq(void (*requestTimeoutExtention)()) { _requestTimeoutExtention = requestTimeoutExtention; }
+	void attachRoundEnergy(void (*handleRoundEnergy)(const RadioEnergy *)) { _handleRoundEnergy = handleRoundEnergy; }
+	void attachTdoaRecord(void (*handleTdoaRecord)(const TdoaRecord *)) { _handleTdoaRecord = handleTdoaRecord; }
+	/* chip interrupts are handled in loop(), this is called from the interrupt task to wake up the task running loop().
+	   Without it a reply (delayed TX) waits for the next loop() call and misses its slot when that comes later than
+	   DEFAULT_REPLY_DELAY_TIME, see examples/IDFRangingTag. */
+	void attachInterruptPending(void (*handleInterruptPending)()) { pDW1000.attachInterruptPendingHandler(handleInterruptPending); }
+
+	// Ranging scheme (only relevant for TAG, ANCHOR answers whatever it is polled with)
+	void setRangingMode(RangingMode mode) { _rangingMode = mode; }
+	RangingMode getRangingMode() { return _rangingMode; }
+
+	// ANCHOR only timestamps the BLINKs of the tags (see attachTdoaRecord()) and answers nothing
+	void setTdoaListener(bool val) { _tdoaListener = val; }
+	bool getTdoaListener() { return _tdoaListener; }
+
+	// Range report delivery (ANCHOR sends, TAG needs UNICAST to reserve reply slots)
+	void setRangeReportMode(RangeReportMode mode) { _rangeReportMode = mode; }
+	RangeReportMode getRangeReportMode() { return _rangeReportMode; }
+
+	// Radio power management (TAG only), call after init() or from the handleReady of initAsync()
+	void setPowerMode(PowerMode mode);
+	PowerMode getPowerMode() { return _powerMode; }
+	const RadioEnergy &getLastRoundEnergy() { return _lastRoundEnergy; }
+
+	// Low power listening of the anchors, all devices of a network have to use the same, call after init()
+	// or from the handleReady of initAsync()
+	void setListenMode(ListenMode mode);
+	ListenMode getListenMode() { return _listenMode; }
+
+	// TAG receiver on only during the reply slots of the anchors, instead of permanently
+	void setBoundedReceive(bool val) { _boundedReceive = val; }
+	bool getBoundedReceive() { return _boundedReceive; }
+
+	// Back-to-back frames (e.g. the POLL_ACKs of several anchors) received without re-arming, call after init()
+	// or from the handleReady of initAsync()
+	void setDoubleBufferedReceive(bool val);
+	bool getDoubleBufferedReceive() { return _doubleBufferedReceive; }
+
+	// TAG receiver turned on by the chip right after the POLL (WAIT4RESP), no host round trip
+	void setWaitForResponse(bool val) { _waitForResponse = val; }
+	bool getWaitForResponse() { return _waitForResponse; }
+
+	// Range filter chain applied to every range before the new range handler (see DW1000RangeFilter),
+	// outliers are dropped without calling the handler
+	void setRangeFilter(const RangeFilterConfig &config) { _rangeFilter.configure(config); }
+	const RangeFilterConfig &getRangeFilter() { return _rangeFilter.getConfig(); }
+
+	// TAG position from the ranges to the anchors with known coordinates (see DW1000Position), weighted by
+	// the range scores and, with the Kalman stage of the range filter, brought to the current time
+	bool setAnchorPosition(uint16_t shortAddress, float x, float y, float z) { return _position.setAnchor(shortAddress, x, y, z); }
+	DW1000Position &getPositioning() { return _position; }
+	bool computePosition(PositionFix &fix);
+
+	// Antenna delay, e.g. restored from a previous calibration, call after init() or from the handleReady of initAsync()
+	// (the delay at the reference temperature while the temperature correction is on)
+	void setAntennaDelay(uint16_t value);
+	uint16_t getAntennaDelay();
+
+	// Temperature correction: temperature and voltage are sampled every samplePeriod ms between the exchanges,
+	// per degree off referenceTemperature the antenna delay moves by delayCoefficient (DW1000 time units) and
+	// the ranges computed here by -rangeCoefficient (m). Call after init() or from the handleReady of initAsync().
+	void setTemperatureCorrection(float delayCoefficient, float rangeCoefficient, float referenceTemperature = 23.0f, uint32_t samplePeriod = DEFAULT_TEMPERATURE_PERIOD);
+	void disableTemperatureCorrection();
+	float getTemperature() { return _temperature; }
+	float getVoltage() { return _voltage; }
+
+	// Antenna delay calibration against known distances (see DW1000AntennaCalibration). Our own ranges are
+	// collected while it runs, the ranges between other nodes are handed over with addCalibrationRange().
+	bool setCalibrationDistance(uint16_t addressA, uint16_t addressB, float meters) { return _antennaCalibration.setDistance(addressA, addressB, meters); }
+	void startAntennaCalibration(uint16_t samplesPerPair);
+	void addCalibrationRange(uint16_t addressA, uint16_t addressB, float meters) { _antennaCalibration.addRange(addressA, addressB, meters); }
+	bool isAntennaCalibrationComplete() { return _antennaCalibration.hasSamples(_calibrationSamples); }
+	// solves and applies our own correction, the corrections of the other nodes are left to the application
+	bool finishAntennaCalibration();
+	DW1000AntennaCalibration &getAntennaCalibration() { return _antennaCalibration; }
+
+	// Crystal trim against a reference node: the clock offset of `frames` frames received from it is averaged
+	// and compensated, then again every repeatPeriod ms (0: once) for the temperature drift. Call after init().
+	void startCrystalCalibration(uint16_t referenceAddress, uint8_t frames, uint32_t repeatPeriod = 0);
+	void stopCrystalCalibration() { _crystalCalibrating = false; _crystalRepeatPeriod = 0; }
+	// trim in use, e.g. to be stored and restored, and the offset to the reference before the last trim in ppm
+	void setCrystalTrim(uint8_t trim) { pDW1000.setCrystalTrim(trim); }
+	uint8_t getCrystalTrim() { return pDW1000.getCrystalTrim(); }
+	float getCrystalOffset() { return _crystalOffset; }
+
+	// Failure and recovery statistics
+	const RangingCounters &getCounters() { return _counters; }
+	void resetCounters() { memset(&_counters, 0, sizeof(_counters)); }
 
 private:
+	// timer wheel ids: timer tick, TAG exchange deadline, TAG wake-up and sleep, one per session, one per device
+	static constexpr uint16_t timerTickId = 0;
+	static constexpr uint16_t exchangeTimerId = 1;
+	static constexpr uint16_t wakeupTimerId = 2;
+	static constexpr uint16_t sleepTimerId = 3;
+	static constexpr uint16_t sessionTimerId = 4;
+	static constexpr uint16_t deviceTimerId = sessionTimerId + MAX_SESSIONS;
+	static constexpr uint16_t timerCount = deviceTimerId + MAX_DEVICES;
+
 	PortableCode &_portable;
 	DW1000 pDW1000;
+	// every deadline of the protocol, see timerCount for the ids
+	TimerWheelNode _timerNodes[timerCount];
+	DW1000TimerWheel _timers;
 
 	// Initialization
+	void initState(const uint8_t *wifiMacAddress, uint16_t shortAddress, bool high_power, const RadioProfile &profile, float payload);
 	void initCommunication(uint8_t myRST, uint8_t mySS, uint8_t myIRQ);
+	void completeInit(BoardType type, uint16_t shortAddress);
+	// false with a warning while the chip is not configured (e.g. during initAsync())
+	bool checkStarted(const char *setting);
 
 	// variables
 	// data buffer
@@ -81,7 +325,7 @@ private:
 	uint8_t sentData[LEN_DATA];
 
 	// Initialization
-	void configureNetwork(uint16_t deviceAddress, uint16_t networkId, const uint8_t mode[]);
+	void configureNetwork(uint16_t deviceAddress, uint16_t networkId, const RadioProfile &profile);
 	void generalStart(bool high_power);
 	bool addNetworkDevices(DW1000Device *device);
 	void removeNetworkDevices(uint8_t index);
@@ -110,6 +354,38 @@ private:
 	static constexpr short pollDeviceSize = 4;
 	static constexpr uint8_t pollAckTimeSlots = 6;
 	static constexpr uint8_t devicePerPollTransmit = 4;
+	// aggregated report entry: short address (2), range (4), RX power (4)
+	static constexpr short rangeReportEntrySize = 10;
+	static constexpr uint8_t maxAggregatedReports = (LEN_DATA - SHORT_MAC_LEN - 2) / rangeReportEntrySize;
+	// margin after the last reply slot before a missing answer counts as timeout, in ms
+	static constexpr uint16_t exchangeTimeoutMargin = 3;
+	// POLL retries within one round, before the round is given up
+	static constexpr uint8_t maxPollRetries = 2;
+	// consecutive failed rounds before the chip is reset and reconfigured
+	static constexpr uint8_t maxFailedExchanges = 3;
+	// a delayed POLL_ACK closer than this to its due time is dropped instead of being sent late
+	static constexpr uint16_t minPollAckLeadUs = 500;
+	// time a session waits for its POLL_ACK to leave, and then for the RANGE, in ms
+	static constexpr uint16_t sessionAckTimeout = 2 * DEFAULT_REPLY_DELAY_TIME / 1000;
+	static constexpr uint16_t sessionRangeTimeout = pollAckTimeSlots * 3 * DEFAULT_REPLY_DELAY_TIME / 1000;
+	// DUTY_CYCLED: wake-up ahead of the round (CS held low, AON upload, PLL lock), in ms
+	static constexpr uint16_t wakeupLeadTime = 6;
+	// DUTY_CYCLED: listening after a BLINK for the RANGING_INIT of the anchors (last random slot), in ms
+	static constexpr uint16_t rangingInitListenTime = 8 * 5 * DEFAULT_REPLY_DELAY_TIME / 2 / 1000 + exchangeTimeoutMargin;
+	// SNIFF: receiver on for sniffOnTime PACs every sniffOffTime us, the TAG preamble spans several periods
+	static constexpr uint8_t sniffOnTime = 2;
+	static constexpr uint8_t sniffOffTime = 128;
+	static constexpr uint8_t sniffPreambleLength = DW1000::TX_PREAMBLE_LEN_1024;
+	// weight of the worst scored ranges in the position fix, they still help the geometry
+	static constexpr float minPositionWeight = 0.1f;
+	// range scoring: RX minus first path power (dB) of a clean line of sight and of a blocked one,
+	// first path to noise ratio of a barely usable and of a clean first path
+	static constexpr float losPowerDifference = 6.0f;
+	static constexpr float nlosPowerDifference = 10.0f;
+	static constexpr float minFirstPathRatio = 2.0f;
+	static constexpr float goodFirstPathRatio = 8.0f;
+	// bounded receive: the window opens this early before the first reply slot and closes this late after the last
+	static constexpr uint16_t receiveWindowGuardUs = 300;
 
 	std::vector<DW1000Device> _networkDevices;
 	volatile uint8_t _networkDevicesNumber;
@@ -117,9 +393,16 @@ private:
 	uint8_t _ownShortAddress[2];
 	uint8_t _lastSentToShortAddress[2];
 	DW1000Mac _globalMac;
-	uint32_t lastTimerTick;
-	uint32_t _replyTimeOfLastPollAck;
-	uint32_t _timeOfLastPollSent;
+	// TAG exchange state machine
+	ExchangeState _exchangeState;
+	uint8_t _exchangeRetries;
+	uint8_t _failedExchanges;
+	// a warm restart was done and no exchange completed since, the next recovery resets the chip
+	bool _warmRestartUnconfirmed;
+	uint8_t _polledDevicesNumber;
+	uint8_t _answeredDevicesNumber;
+	uint8_t _reportedDevicesNumber;
+	RangingCounters _counters;
 	float _payload;
 	int16_t counterForBlink;
 
@@ -131,12 +414,30 @@ private:
 	void (*_handleInactiveDevice)(DW1000Device *);
 	void (*_handleRemovedDeviceMaxReached)(DW1000Device *);
 	void (*_requestTimeoutExtention)();
+	void (*_handleRoundEnergy)(const RadioEnergy *);
+	void (*_handleTdoaRecord)(const TdoaRecord *);
 
 	// Board type (tag or anchor)
-	BoardType _type;
+	BoardType _type = BoardType::TAG;
+	// the chip is brought up and configured, loop() runs the protocol
+	bool _started = false;
+	// Ranging scheme
+	RangingMode _rangingMode;
+	// ANCHOR passive TDoA listening
+	bool _tdoaListener;
+	// Range report delivery and the reports waiting for the next aggregated frame
+	RangeReportMode _rangeReportMode;
+	uint8_t _pendingReports[maxAggregatedReports * rangeReportEntrySize];
+	uint8_t _pendingReportsNumber;
+	// ANCHOR exchanges in flight
+	RangingSession _sessions[MAX_SESSIONS];
 	// Message sent/received state
 	volatile bool _sentAck;
 	volatile bool _receivedAck;
+	volatile bool _receiveTimedOut;
+	bool _boundedReceive;
+	bool _waitForResponse;
+	bool _doubleBufferedReceive;
 	// Protocol error state
 	bool _protocolFailed;
 	// Reset line to the chip
@@ -151,28 +452,111 @@ private:
 	uint16_t _rangeInterval;
 	// Ranging counter (per second)
 	uint32_t _rangingCountPeriod;
-	bool _first;
+	// radio power management and energy bookkeeping
+	ListenMode _listenMode;
+	PowerMode _powerMode;
+	RadioState _radioState;
+	// in us, ahead of the current time while a delayed start or a frame on air is booked already
+	uint32_t _radioStateSince;
+	RadioEnergy _roundEnergy;
+	RadioEnergy _lastRoundEnergy;
+	// per-device range filters, indexed like _networkDevices
+	DW1000RangeFilter _rangeFilter;
+	// anchor coordinates and last position fix
+	DW1000Position _position;
+	// antenna delay calibration in progress
+	DW1000AntennaCalibration _antennaCalibration;
+	bool _antennaCalibrating;
+	uint16_t _calibrationSamples;
+	// crystal trim in progress, against the clock of the reference node
+	bool _crystalCalibrating;
+	uint16_t _crystalReference;
+	uint8_t _crystalFrames;
+	uint8_t _crystalSamples;
+	float _crystalOffsetSum;
+	float _crystalOffset;
+	uint32_t _crystalRepeatPeriod;
+	uint32_t _crystalCalibrationDue;
+	// temperature correction of the antenna delay and the range bias
+	bool _temperatureCorrection;
+	float _delayCoefficient;
+	float _rangeCoefficient;
+	float _referenceTemperature;
+	uint32_t _temperaturePeriod;
+	uint32_t _temperatureDue;
+	float _temperature;
+	float _voltage;
+	uint16_t _baseAntennaDelay;
+	// configuration kept to restore the chip after a reset
+	RadioProfile _profile;
+	bool _highPower;
 
 	// Methods
 	void handleSent();
 	void handleReceived();
+	void handleReceiveFailed();
+	void handleReceiveTimeout();
+	// range goes through the range filter before it is stored on the device, a dropped outlier leaves the
+	// last accepted range in place. rawRange is the range before the temperature correction, the one the
+	// antenna calibration collects. powers are the ones of the frame that brought the range, for a
+	// reported range the report itself
+	void handleNewRange(DW1000Device *myDistantDevice, float range, float rawRange, const FramePowers &powers);
+	FramePowers readFramePowers();
+	void sampleCrystalOffset(uint8_t address[]);
 	void noteActivity();
 	void resetInactive();
 
 	// Global functions:
 	void checkForReset();
-	void checkForInactiveDevices();
+	void handleTimerExpired(uint16_t id);
+	void handleDeviceTimeout(uint8_t index);
+	void handleExchangeTimeout();
+	void startExchange(ExchangeState state, uint32_t timeout);
+	void finishPollAckPhase();
+	void completeExchange();
+	void recoverReceiver();
+	void reinitChip();
+
+	// TAG radio power management
+	void sleepRadio();
+	void wakeRadio();
+	void scheduleSleep(uint32_t delay);
+	void setRadioState(RadioState state);
+	void bookRadioTime(RadioState state, uint32_t us);
+	void addRadioTime(RadioState state, uint32_t us);
+	void noteTransmit(uint16_t length, uint32_t delayUs);
+	void closeEnergyRound();
+	void applyListenMode();
 
 	// ANCHOR ranging protocol
 	void transmitInit();
-	void transmit(uint8_t datas[]);
+	void transmit(uint8_t datas[], uint16_t length = LEN_DATA, uint32_t delayUs = 0);
 	void transmit(uint8_t datas[], DW1000Time time);
 	void transmitBlink();
+	void transmitTdoaBlink();
 	void transmitRangingInit(DW1000Device *myDistantDevice, uint16_t delay = 0);
-	void transmitPollAck(DW1000Device *myDistantDevice, uint16_t delay);
-	void transmitRangeReport(DW1000Device *myDistantDevice, uint16_t delay);
+	void transmitPollAck(RangingSession *session, uint32_t leadUs);
+	// the range as computed, before the range filter of the anchor
+	void transmitRangeReport(DW1000Device *myDistantDevice, float range, uint16_t delay);
 	void transmitRangeFailed(DW1000Device *myDistantDevice);
+	void queueRangeReport(DW1000Device *myDistantDevice, float range);
+	void transmitAggregatedRangeReport();
 	void receiver();
+	void openReceiveWindow(const DW1000Time &start, uint32_t windowUs);
+	uint32_t getPollAckWindowStart();
+	uint32_t getPollAckWindowLength();
+
+	// ANCHOR TDoA listener
+	void receiveTdoaBlink();
+
+	// ANCHOR session table
+	RangingSession *openSession(uint8_t tagAddress[]);
+	RangingSession *searchSession(uint8_t tagAddress[], SessionState state);
+	void closeSession(RangingSession *session);
+	bool isPollAckScheduled();
+	void scheduleNextPollAck();
+	void armSessionTimer(RangingSession *session, uint32_t timeout);
+	void handleSessionTimeout(uint8_t index);
 
 	// TAG ranging protocol
 	void transmitPoll();
@@ -181,5 +565,10 @@ private:
 	// Methods for range computation
 	void timerTick();
 	void computeRangeAsymmetric(DW1000Device *myDistantDevice, DW1000Time *myTOF);
+	void computeRangeSingleSided(DW1000Device *myDistantDevice, DW1000Time *myTOF);
+	float correctRange(float range);
+	void scoreRange(DW1000Device *myDistantDevice, const FramePowers &powers);
+	void sampleTemperature();
+	void applyAntennaDelay();
 	uint16_t getReplyTimeOfIndex(int i);
 };
@@ -0,0 +1,194 @@
+#include "DW1000TimerWheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+DW1000TimerWheel::DW1000TimerWheel(TimerWheelNode nodes[], uint16_t count) : _nodes(nodes), _count(count)
+{
+	_handleExpired = nullptr;
+	reset(0);
+}
+
+void DW1000TimerWheel::reset(uint32_t now)
+{
+	for (uint16_t i = 0; i < _count; i++)
+	{
+		_nodes[i].list = nullptr;
+		_nodes[i].next = NO_TIMER;
+		_nodes[i].prev = NO_TIMER;
+	}
+	for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		for (uint8_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+		{
+			_buckets[level][slot] = NO_TIMER;
+		}
+	}
+	_expired = NO_TIMER;
+	_armed = 0;
+	_now = now;
+}
+
+bool DW1000TimerWheel::arm(uint16_t id, uint32_t delay)
+{
+	return armAt(id, _now + delay);
+}
+
+bool DW1000TimerWheel::armAt(uint16_t id, uint32_t expiry)
+{
+	if (id >= _count)
+	{
+		return false;
+	}
+	unlink(id);
+	// the current tick is already processed, the earliest is the next one
+	if ((int32_t)(expiry - _now) <= 0)
+	{
+		expiry = _now + 1;
+	}
+	_nodes[id].expiry = expiry;
+	place(id);
+	_armed++;
+	return true;
+}
+
+void DW1000TimerWheel::cancel(uint16_t id)
+{
+	if (id >= _count || _nodes[id].list == nullptr)
+	{
+		return;
+	}
+	unlink(id);
+}
+
+void DW1000TimerWheel::move(uint16_t from, uint16_t to)
+{
+	if (from == to || from >= _count || to >= _count)
+	{
+		return;
+	}
+	cancel(to);
+	if (_nodes[from].list == nullptr)
+	{
+		return;
+	}
+	uint32_t expiry = _nodes[from].expiry;
+	cancel(from);
+	armAt(to, expiry);
+}
+
+void DW1000TimerWheel::advance(uint32_t now)
+{
+	while ((int32_t)(now - _now) > 0)
+	{
+		if (_armed == 0)
+		{
+			// nothing to expire, jump straight to the current time
+			_now = now;
+			return;
+		}
+		_now++;
+		uint8_t slot = _now & TIMER_WHEEL_MASK;
+		if (slot == 0)
+		{
+			// a lower level wrapped, bring the timers of the next block one level down
+			uint8_t slot1 = (_now >> TIMER_WHEEL_BITS) & TIMER_WHEEL_MASK;
+			if (slot1 == 0)
+			{
+				cascade(2, (_now >> (2 * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+			}
+			cascade(1, slot1);
+		}
+
+		// detach the bucket, handlers may re-arm or cancel any timer meanwhile
+		while (_buckets[0][slot] != NO_TIMER)
+		{
+			uint16_t id = _buckets[0][slot];
+			unlink(id);
+			link(id, &_expired);
+			_armed++;
+		}
+		while (_expired != NO_TIMER)
+		{
+			uint16_t id = _expired;
+			unlink(id);
+			if (_handleExpired != nullptr)
+			{
+				_handleExpired(id);
+			}
+		}
+	}
+}
+
+void DW1000TimerWheel::link(uint16_t id, uint16_t *list)
+{
+	TimerWheelNode &node = _nodes[id];
+	node.list = list;
+	node.prev = NO_TIMER;
+	node.next = *list;
+	if (*list != NO_TIMER)
+	{
+		_nodes[*list].prev = id;
+	}
+	*list = id;
+}
+
+void DW1000TimerWheel::unlink(uint16_t id)
+{
+	TimerWheelNode &node = _nodes[id];
+	if (node.list == nullptr)
+	{
+		return;
+	}
+	if (node.prev != NO_TIMER)
+	{
+		_nodes[node.prev].next = node.next;
+	}
+	else
+	{
+		*node.list = node.next;
+	}
+	if (node.next != NO_TIMER)
+	{
+		_nodes[node.next].prev = node.prev;
+	}
+	node.list = nullptr;
+	node.next = NO_TIMER;
+	node.prev = NO_TIMER;
+	_armed--;
+}
+
+void DW1000TimerWheel::place(uint16_t id)
+{
+	uint32_t expiry = _nodes[id].expiry;
+	uint32_t delta = expiry - _now;
+	if (delta < TIMER_WHEEL_SLOTS)
+	{
+		link(id, &_buckets[0][expiry & TIMER_WHEEL_MASK]);
+	}
+	else if (delta < (1UL << (2 * TIMER_WHEEL_BITS)))
+	{
+		link(id, &_buckets[1][(expiry >> TIMER_WHEEL_BITS) & TIMER_WHEEL_MASK]);
+	}
+	else
+	{
+		if (delta >= (1UL << (3 * TIMER_WHEEL_BITS)))
+		{
+			// beyond the horizon, clamp to the last slot
+			expiry = _now + (1UL << (3 * TIMER_WHEEL_BITS)) - 1;
+			_nodes[id].expiry = expiry;
+		}
+		link(id, &_buckets[2][(expiry >> (2 * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK]);
+	}
+}
+
+void DW1000TimerWheel::cascade(uint8_t level, uint8_t slot)
+{
+	uint16_t *list = &_buckets[level][slot];
+	while (*list != NO_TIMER)
+	{
+		uint16_t id = *list;
+		unlink(id);
+		_armed++;
+		place(id);
+	}
+}
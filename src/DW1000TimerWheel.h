@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+
+// 3 levels of 64 slots, 1 ms resolution: 64 ms, 4.096 s and 262.144 s horizons
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 3
+
+// one timer, storage is provided by the owner of the wheel
+struct TimerWheelNode
+{
+	uint32_t expiry;
+	uint16_t next;
+	uint16_t prev;
+	// list head the node is linked in, nullptr when not armed
+	uint16_t *list;
+};
+
+/**
+Hierarchical timer wheel with millisecond ticks. Timers are identified by their index in the
+node array handed to the constructor, so arming, re-arming and cancelling are O(1) and never
+allocate. The cost of advance() grows with the elapsed ticks and the number of expirations,
+not with the number of armed timers.
+
+Delays beyond the last level horizon are clamped to it.
+*/
+class DW1000TimerWheel
+{
+public:
+	static constexpr uint16_t NO_TIMER = 0xFFFF;
+
+	DW1000TimerWheel(TimerWheelNode nodes[], uint16_t count);
+
+	// cancel all timers and restart the wheel at the given time
+	void reset(uint32_t now);
+
+	// (re-)arm timer id to expire at now + delay, or at an absolute time, returns false for an unknown id
+	bool arm(uint16_t id, uint32_t delay);
+	bool armAt(uint16_t id, uint32_t expiry);
+	void cancel(uint16_t id);
+	bool isArmed(uint16_t id) { return _nodes[id].list != nullptr; }
+	uint32_t getExpiry(uint16_t id) { return _nodes[id].expiry; }
+
+	// move an armed timer to another id (e.g. the owning table entry was moved), `to` is cancelled first
+	void move(uint16_t from, uint16_t to);
+
+	// run all ticks up to now, calling the expired handler for each timer that expires
+	void advance(uint32_t now);
+
+	uint32_t getTime() { return _now; }
+
+	void attachExpiredHandler(std::function<void(uint16_t)> handleExpired)
+	{
+		_handleExpired = handleExpired;
+	}
+
+private:
+	TimerWheelNode *_nodes;
+	uint16_t _count;
+	uint16_t _armed;
+	uint32_t _now;
+	uint16_t _buckets[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	// timers of the tick being processed, so that handlers may cancel any of them
+	uint16_t _expired;
+
+	std::function<void(uint16_t)> _handleExpired;
+
+	void link(uint16_t id, uint16_t *list);
+	void unlink(uint16_t id);
+	void place(uint16_t id);
+	void cascade(uint8_t level, uint8_t slot);
+};
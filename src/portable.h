@@ -17,10 +17,21 @@ public:
 	virtual void delay_ms(uint32_t) = 0;
 	virtual void delay_us(uint32_t) = 0;
 	virtual uint32_t millis() = 0;
+	// free running microseconds, wrapping; ports without a finer clock fall back to millis()
+	virtual uint32_t micros() { return millis() * 1000; }
 
 	virtual void begin() = 0;
 
 	virtual void dw1000_reset(void) = 0;
+	// drive (true) or release (false) the reset line, for a reset without blocking. Ports that
+	// do not override it do the blocking dw1000_reset() when driving and nothing on release.
+	virtual void dw1000_set_reset(bool asserted)
+	{
+		if (asserted)
+		{
+			dw1000_reset();
+		}
+	}
 	virtual void dw1000_select(bool) = 0;
 	virtual void dw1000_irq_isr(std::function<void()>) = 0;
 	virtual void dw1000_spi_read(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen) = 0;
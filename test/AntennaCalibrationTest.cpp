@@ -0,0 +1,136 @@
+#include <random>
+#include "Test.h"
+#include "DW1000AntennaCalibration.h"
+#include "DW1000Time.h"
+
+// five nodes in a room (m), with the range error (m) their antenna delay causes on every range
+#define TEST_NODES 5
+static const uint16_t addresses[TEST_NODES] = {0x0101, 0x0102, 0x0103, 0x0104, 0x0105};
+static const float positions[TEST_NODES][3] = {{0, 0, 2.5f}, {8, 0, 2.5f}, {8, 6, 2.5f}, {0, 6, 2.5f}, {4, 3, 1}};
+static const float delayErrors[TEST_NODES] = {0.05f, -0.08f, 0.12f, 0, -0.03f};
+
+static float distance(uint8_t a, uint8_t b)
+{
+	float dx = positions[a][0] - positions[b][0];
+	float dy = positions[a][1] - positions[b][1];
+	float dz = positions[a][2] - positions[b][2];
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// ranges between every pair, off by the delay errors of both nodes and gaussian noise
+static void measureAllPairs(DW1000AntennaCalibration &calibration, uint16_t samples, float noise)
+{
+	std::mt19937 generator(43);
+	std::normal_distribution<float> gaussian(0, noise > 0 ? noise : 1);
+	for (uint8_t a = 0; a < TEST_NODES; a++)
+	{
+		for (uint8_t b = a + 1; b < TEST_NODES; b++)
+		{
+			calibration.setDistance(addresses[a], addresses[b], distance(a, b));
+			for (uint16_t i = 0; i < samples; i++)
+			{
+				float range = distance(a, b) + delayErrors[a] + delayErrors[b] + (noise > 0 ? gaussian(generator) : 0);
+				calibration.addRange(addresses[b], addresses[a], range);
+			}
+		}
+	}
+}
+
+static void checkCorrections(DW1000AntennaCalibration &calibration, int16_t tolerance)
+{
+	CHECK(calibration.getNodesNumber() == TEST_NODES);
+	for (uint8_t i = 0; i < TEST_NODES; i++)
+	{
+		// a range too long by e needs a delay longer by e
+		int16_t expected = (int16_t)lroundf(delayErrors[i] * DW1000Time::DISTANCE_OF_RADIO_INV);
+		int16_t correction = 0;
+		CHECK(calibration.getCorrection(addresses[i], correction));
+		CHECK_NEAR(correction, expected, tolerance);
+	}
+}
+
+static void testExactRanges()
+{
+	DW1000AntennaCalibration calibration;
+	measureAllPairs(calibration, 1, 0);
+	CHECK(calibration.hasSamples(1));
+	CHECK(calibration.solve());
+	checkCorrections(calibration, 0);
+	CHECK_NEAR(calibration.getResidual(), 0, 1e-4);
+	// every node takes part in the ranges of its four pairs
+	CHECK(calibration.getCorrection((uint8_t)0).samples == TEST_NODES - 1);
+}
+
+static void testNoisyRanges()
+{
+	DW1000AntennaCalibration calibration;
+	measureAllPairs(calibration, 200, 0.05f);
+	CHECK(calibration.hasSamples(200));
+	CHECK(!calibration.hasSamples(201));
+	CHECK(calibration.solve());
+	// the mean of 200 ranges is within a few mm, one time unit is 4.7 mm
+	checkCorrections(calibration, 1);
+	CHECK(calibration.getResidual() < 0.01f);
+}
+
+static void testClearRanges()
+{
+	// a first run with every range 10 cm too long, then restarted
+	DW1000AntennaCalibration calibration;
+	measureAllPairs(calibration, 1, 0);
+	for (uint8_t a = 0; a < TEST_NODES; a++)
+	{
+		for (uint8_t b = a + 1; b < TEST_NODES; b++)
+			calibration.addRange(addresses[a], addresses[b], distance(a, b) + 0.1f);
+	}
+	calibration.clearRanges();
+	CHECK(!calibration.hasSamples(1));
+
+	// the known distances are kept, only the new ranges count
+	for (uint8_t a = 0; a < TEST_NODES; a++)
+	{
+		for (uint8_t b = a + 1; b < TEST_NODES; b++)
+			calibration.addRange(addresses[a], addresses[b], distance(a, b) + delayErrors[a] + delayErrors[b]);
+	}
+	CHECK(calibration.hasSamples(1));
+	CHECK(calibration.solve());
+	checkCorrections(calibration, 0);
+}
+
+static void testUndeterminedPairs()
+{
+	// two nodes: only the sum of their errors is known
+	DW1000AntennaCalibration pair;
+	pair.setDistance(addresses[0], addresses[1], 5);
+	pair.addRange(addresses[0], addresses[1], 5.1f);
+	CHECK(!pair.hasSamples(1));
+	CHECK(!pair.solve());
+
+	// a square without diagonals: e0 + e1, e1 + e2, e2 + e3 and e3 + e0 do not split
+	DW1000AntennaCalibration square;
+	for (uint8_t a = 0; a < 4; a++)
+	{
+		uint8_t b = (a + 1) % 4;
+		square.setDistance(addresses[a], addresses[b], distance(a, b));
+		square.addRange(addresses[a], addresses[b], distance(a, b) + delayErrors[a] + delayErrors[b]);
+	}
+	CHECK(!square.solve());
+
+	// ranges of pairs without a known distance are ignored, they would close the chain 0-1-2 to a triangle
+	DW1000AntennaCalibration chain;
+	chain.setDistance(addresses[0], addresses[1], distance(0, 1));
+	chain.setDistance(addresses[1], addresses[2], distance(1, 2));
+	chain.addRange(addresses[0], addresses[1], distance(0, 1));
+	chain.addRange(addresses[1], addresses[2], distance(1, 2));
+	chain.addRange(addresses[0], addresses[2], distance(0, 2));
+	CHECK(chain.hasSamples(1));
+	CHECK(!chain.solve());
+}
+
+void runAntennaCalibrationTests()
+{
+	testExactRanges();
+	testNoisyRanges();
+	testClearRanges();
+	testUndeterminedPairs();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include "HostPort.h"
+
+// cost of one call: SPI traffic and time on the HostPort clock (bus and delays), host CPU time
+struct BenchmarkCost
+{
+	float transactions;
+	float bytes;
+	float busUs;
+	float elapsedUs;
+	float hostUs;
+};
+
+// runs f(i) for i in [0, calls) and returns the cost per call, the port counters are reset first
+template <typename F>
+BenchmarkCost measureCost(HostPort &port, uint32_t calls, F f)
+{
+	port.resetCounters();
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		f(i);
+	}
+	auto end = std::chrono::steady_clock::now();
+	BenchmarkCost cost;
+	cost.transactions = (float)port.getTransactions() / calls;
+	cost.bytes = (float)port.getBytes() / calls;
+	cost.busUs = port.getBusTimeUs() / calls;
+	cost.elapsedUs = port.getElapsedUs() / calls;
+	cost.hostUs = std::chrono::duration<float, std::micro>(end - start).count() / calls;
+	return cost;
+}
+
+inline void printCostHeader(const char *title)
+{
+	printf("\n%s\n%-50s %9s %8s %10s %10s %10s\n", title, "", "transfers", "bytes", "bus us", "elapsed us", "host us");
+}
+
+inline void printCost(const char *name, const BenchmarkCost &cost)
+{
+	printf("%-50s %9.1f %8.1f %10.1f %10.1f %10.2f\n", name, cost.transactions, cost.bytes, cost.busUs, cost.elapsedUs, cost.hostUs);
+}
+
+// each returns false if a sanity check of its results failed
+bool runModeSwitchBenchmark();
+bool runRecoveryBenchmark();
+bool runCIRBenchmark();
+bool runPositionBenchmark();
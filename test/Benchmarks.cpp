@@ -0,0 +1,16 @@
+#include "Benchmark.h"
+
+/*
+ * Host benchmarks of the driver against HostPort. Bus times are at the SPI clocks of the IDF port
+ * (16 MHz, 2 MHz while the chip runs on the crystal clock) without the per transfer overhead of the
+ * SPI driver, elapsed times add the delays the driver waits for.
+ */
+int main()
+{
+	bool ok = true;
+	ok &= runModeSwitchBenchmark();
+	ok &= runRecoveryBenchmark();
+	ok &= runCIRBenchmark();
+	ok &= runPositionBenchmark();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "Benchmark.h"
+#include "DW1000.h"
+
+// accumulator sample i holds (i, -i), the first path at sample 745 (10.6 fixed point)
+static void fillAccumulator(HostPort &port)
+{
+	for (uint16_t i = 0; i < ACC_SAMPLES_64MHZ; i++)
+	{
+		int16_t imaginary = -(int16_t)i;
+		uint8_t sample[LEN_ACC_SAMPLE] = {(uint8_t)i, (uint8_t)(i >> 8), (uint8_t)imaginary, (uint8_t)(imaginary >> 8)};
+		port.setRegister(ACC_MEM, i * LEN_ACC_SAMPLE, sample, LEN_ACC_SAMPLE);
+	}
+	uint16_t firstPath = 745 << 6;
+	uint8_t fpIndex[LEN_FP_INDEX] = {(uint8_t)firstPath, (uint8_t)(firstPath >> 8)};
+	port.setRegister(RX_TIME, FP_INDEX_SUB, fpIndex, LEN_FP_INDEX);
+}
+
+bool runCIRBenchmark()
+{
+	HostPort port;
+	DW1000 dw1000(port);
+	dw1000.begin();
+	dw1000.newConfiguration();
+	dw1000.setDefaults();
+	dw1000.enableProfile(PROFILE_SHORTDATA_FAST_ACCURACY);
+	dw1000.commitConfiguration();
+	fillAccumulator(port);
+
+	const uint16_t counts[] = {16, 64, 128};
+	const uint8_t decimations[] = {1, 2, 4};
+	static int16_t samples[(DW1000::getCIRReadBytes(128, 4) + 1) / 2];
+	const uint32_t reads = 1000;
+	bool ok = true;
+	printCostHeader("CIR window readout, readCIR() 8 samples ahead of the first path (per window)");
+	for (uint16_t count : counts)
+	{
+		for (uint8_t decimation : decimations)
+		{
+			// a window running past the end of the accumulator is cut
+			uint16_t expected = count;
+			if (745 - 8 + (count - 1) * decimation >= ACC_SAMPLES_64MHZ)
+			{
+				expected = (ACC_SAMPLES_64MHZ - 1 - (745 - 8)) / decimation + 1;
+			}
+			BenchmarkCost cost = measureCost(port, reads, [&](uint32_t)
+											 { ok &= dw1000.readCIR(samples, count, 8, decimation) == expected; });
+			char name[64];
+			snprintf(name, sizeof(name), "%u samples, decimation %u%s", count, decimation, expected < count ? " (cut)" : "");
+			printCost(name, cost);
+			for (uint16_t i = 0; i < expected; i++)
+			{
+				int16_t index = 745 - 8 + i * decimation;
+				ok &= samples[2 * i] == index && samples[2 * i + 1] == -index;
+			}
+		}
+	}
+	if (!ok)
+	{
+		printf("readCIR() samples differ from the accumulator\n");
+	}
+	return ok;
+}
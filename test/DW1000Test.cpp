@@ -0,0 +1,97 @@
+#include "Test.h"
+#include "HostPort.h"
+#include "DW1000.h"
+#include <type_traits>
+
+// a profile only comes out of makeRadioProfile(), which checks it
+static_assert(!std::is_constructible<RadioProfile, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, bool>::value, "RadioProfile built around the checks");
+static_assert(!std::is_default_constructible<RadioProfile>::value, "RadioProfile built around the checks");
+
+static void configure(DW1000 &dw1000)
+{
+	dw1000.begin();
+	dw1000.newConfiguration();
+	dw1000.setDefaults();
+	dw1000.enableProfile(PROFILE_SHORTDATA_FAST_ACCURACY);
+	dw1000.commitConfiguration();
+}
+
+static void setSystemTime(HostPort &port, float timeUs)
+{
+	uint8_t time[LEN_SYS_TIME];
+	DW1000Time(timeUs).getTimestamp(time);
+	port.setRegister(SYS_TIME, 0, time, LEN_SYS_TIME);
+}
+
+// a good frame at timeUs, handled by the driver
+static void receiveFrame(HostPort &port, float timeUs)
+{
+	setSystemTime(port, timeUs);
+	uint8_t status[LEN_SYS_STATUS] = {};
+	status[RXDFR_BIT / 8] |= 1 << (RXDFR_BIT % 8);
+	status[RXFCG_BIT / 8] |= 1 << (RXFCG_BIT % 8);
+	port.setRegister(SYS_STATUS, 0, status, LEN_SYS_STATUS);
+	port.raiseInterrupt();
+}
+
+static uint16_t getFrameWaitTimeout(HostPort &port)
+{
+	uint8_t fwto[LEN_RX_FWTO];
+	port.getRegister(RX_FWTO, 0, fwto, LEN_RX_FWTO);
+	return (uint16_t)fwto[1] << 8 | fwto[0];
+}
+
+static bool isReceiverEnabled(HostPort &port)
+{
+	uint8_t sysctrl[LEN_SYS_CTRL];
+	port.getRegister(SYS_CTRL, 0, sysctrl, LEN_SYS_CTRL);
+	return sysctrl[RXENAB_BIT / 8] & (1 << (RXENAB_BIT % 8));
+}
+
+static void testReceiveWindow()
+{
+	HostPort port;
+	DW1000 dw1000(port);
+	configure(dw1000);
+	uint8_t frames = 0, timeouts = 0;
+	dw1000.attachReceivedHandler([&]()
+								 { frames++; });
+	dw1000.attachReceiveTimeoutHandler([&]()
+									   { timeouts++; });
+
+	// a 2 ms window from 1 ms on, re-armed after every frame
+	setSystemTime(port, 1000);
+	dw1000.newReceive();
+	dw1000.setDefaults();
+	dw1000.receivePermanently(true);
+	dw1000.setFrameWaitTimeout(2000);
+	dw1000.setReceiveWindowEnd(DW1000Time(3000.0f));
+	dw1000.startReceive();
+	CHECK_NEAR(getFrameWaitTimeout(port), 2000 * 4992 / 5120, 1);
+
+	// for what is left of it, not the full length again
+	receiveFrame(port, 2500);
+	CHECK(frames == 1);
+	CHECK(isReceiverEnabled(port));
+	CHECK_NEAR(getFrameWaitTimeout(port), 500 * 4992 / 5120, 1);
+
+	// a frame at its very end: the window is over, no re-arm
+	receiveFrame(port, 2999);
+	CHECK(frames == 2);
+	CHECK(timeouts == 1);
+	CHECK(!isReceiverEnabled(port));
+
+	// unbounded again after setFrameWaitTimeout(0)
+	dw1000.setFrameWaitTimeout(0);
+	dw1000.newReceive();
+	dw1000.startReceive();
+	receiveFrame(port, 5000);
+	CHECK(frames == 3);
+	CHECK(isReceiverEnabled(port));
+	CHECK(getFrameWaitTimeout(port) == 0);
+}
+
+void runDW1000Tests()
+{
+	testReceiveWindow();
+}
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "HostPort.h"
+#include "DW1000Constants.h"
+
+#define HOST_REGISTER_SIZE (1 << 15)
+
+HostPort::HostPort() : _memory(64 * HOST_REGISTER_SIZE)
+{
+	_speed = FAST_SPI;
+	_clockNs = 0;
+	powerOnReset();
+	resetCounters();
+}
+
+void HostPort::powerOnReset()
+{
+	memset(_memory.data(), 0, _memory.size());
+	// DW1000 device identifier 0xDECA0130 and the reset address 0xFFFFFFFF
+	const uint8_t devId[LEN_DEV_ID] = {0x30, 0x01, 0xCA, 0xDE};
+	const uint8_t panadr[LEN_PANADR] = {0xFF, 0xFF, 0xFF, 0xFF};
+	setRegister(DEV_ID, 0, devId, LEN_DEV_ID);
+	setRegister(PANADR, 0, panadr, LEN_PANADR);
+}
+
+void HostPort::dw1000_reset(void)
+{
+	// the IDF port holds the line for 2 ms, then waits 10 ms for the chip
+	dw1000_set_reset(true);
+	delay_ms(2);
+	dw1000_set_reset(false);
+	delay_ms(10);
+}
+
+void HostPort::dw1000_set_reset(bool asserted)
+{
+	if (asserted)
+	{
+		powerOnReset();
+	}
+}
+
+void HostPort::setRegister(uint8_t cmd, uint16_t offset, const uint8_t data[], uint16_t n)
+{
+	memcpy(&_memory[(uint32_t)(cmd & 0x3F) * HOST_REGISTER_SIZE + offset], data, n);
+}
+
+void HostPort::getRegister(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n)
+{
+	memcpy(data, &_memory[(uint32_t)(cmd & 0x3F) * HOST_REGISTER_SIZE + offset], n);
+}
+
+uint32_t HostPort::decodeHeader(const uint8_t *header, size_t hLen, uint8_t &cmd)
+{
+	// see DW1000::readBytes(): register id, then an optional 7 or 15 bit sub-address
+	cmd = header[0] & 0x3F;
+	uint32_t offset = 0;
+	if (hLen > 1)
+	{
+		offset = header[1] & 0x7F;
+	}
+	if (hLen > 2)
+	{
+		offset |= (uint32_t)header[2] << 7;
+	}
+	return offset;
+}
+
+void HostPort::dw1000_spi_read(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen)
+{
+	uint8_t cmd;
+	uint32_t offset = decodeHeader(header, hLen, cmd);
+	countTransaction(hLen + dLen);
+	if (cmd == ACC_MEM && dLen > 0)
+	{
+		// the accumulator answers with a dummy byte first
+		data[0] = 0;
+		data++;
+		dLen--;
+	}
+	if (offset + dLen > HOST_REGISTER_SIZE)
+	{
+		dLen = offset < HOST_REGISTER_SIZE ? HOST_REGISTER_SIZE - offset : 0;
+	}
+	getRegister(cmd, offset, data, dLen);
+}
+
+void HostPort::dw1000_spi_write(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen)
+{
+	uint8_t cmd;
+	uint32_t offset = decodeHeader(header, hLen, cmd);
+	countTransaction(hLen + dLen);
+	if (offset + dLen > HOST_REGISTER_SIZE)
+	{
+		dLen = offset < HOST_REGISTER_SIZE ? HOST_REGISTER_SIZE - offset : 0;
+	}
+	setRegister(cmd, offset, data, dLen);
+}
+
+void HostPort::countTransaction(size_t n)
+{
+	uint64_t ns = (uint64_t)n * 8 * 1000000000ULL / (_speed == FAST_SPI ? FAST_SPI_HZ : SLOW_SPI_HZ);
+	_transactions++;
+	_bytes += n;
+	_busTimeNs += ns;
+	_clockNs += ns;
+}
+
+void HostPort::resetCounters()
+{
+	_transactions = 0;
+	_bytes = 0;
+	_busTimeNs = 0;
+	_counterStartNs = _clockNs;
+}
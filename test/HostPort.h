@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "portable.h"
+
+/**
+Host stand-in for a port, to run the driver without a chip. The DW1000 registers are kept in memory
+(writes are stored, reads return what was written), delays advance a virtual clock instead of
+waiting, and every SPI transaction is counted and advances the clock by its time on the bus at the
+selected speed.
+*/
+class HostPort : public PortableCode
+{
+public:
+	// the SPI clocks of the IDF port
+	static constexpr uint32_t FAST_SPI_HZ = 16000000;
+	static constexpr uint32_t SLOW_SPI_HZ = 2000000;
+
+	HostPort();
+
+	void delay_ms(uint32_t ms) { _clockNs += (uint64_t)ms * 1000000; }
+	void delay_us(uint32_t us) { _clockNs += (uint64_t)us * 1000; }
+	uint32_t millis() { return (uint32_t)(_clockNs / 1000000); }
+	uint32_t micros() { return (uint32_t)(_clockNs / 1000); }
+
+	void begin() {}
+
+	void dw1000_reset(void);
+	void dw1000_set_reset(bool asserted);
+	void dw1000_select(bool) {}
+	void dw1000_irq_isr(std::function<void()> isr) { _isr = isr; }
+	void dw1000_spi_read(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen);
+	void dw1000_spi_write(uint8_t *header, size_t hLen, uint8_t *data, size_t dLen);
+	void dw1000_set_spi_speed(dw1000_spi_speed_t speed) { _speed = speed; }
+
+	int random(int min, int) { return min; }
+
+	void log_err(const std::string &, const char *, ...) {}
+	void log_war(const std::string &, const char *, ...) {}
+	void log_inf(const std::string &, const char *, ...) {}
+	void log_dbg(const std::string &, const char *, ...) {}
+	void log_vrb(const std::string &, const char *, ...) {}
+
+	// register memory as after a power on: all zero, but the device identifier and the address
+	void powerOnReset();
+	void setRegister(uint8_t cmd, uint16_t offset, const uint8_t data[], uint16_t n);
+	void getRegister(uint8_t cmd, uint16_t offset, uint8_t data[], uint16_t n);
+	// the IRQ line, as raised by the chip
+	void raiseInterrupt()
+	{
+		if (_isr)
+		{
+			_isr();
+		}
+	}
+
+	// SPI traffic and virtual time (delays and bus time) since the last resetCounters()
+	void resetCounters();
+	uint32_t getTransactions() { return _transactions; }
+	uint32_t getBytes() { return _bytes; }
+	float getBusTimeUs() { return _busTimeNs / 1000.0f; }
+	float getElapsedUs() { return (_clockNs - _counterStartNs) / 1000.0f; }
+
+private:
+	// 64 register files of up to 2^15 bytes, addressed like the SPI header does
+	std::vector<uint8_t> _memory;
+	std::function<void()> _isr;
+	dw1000_spi_speed_t _speed;
+	uint64_t _clockNs;
+	uint64_t _counterStartNs;
+	uint32_t _transactions;
+	uint32_t _bytes;
+	uint64_t _busTimeNs;
+
+	uint32_t decodeHeader(const uint8_t *header, size_t hLen, uint8_t &cmd);
+	void countTransaction(size_t n);
+};
@@ -0,0 +1,57 @@
+#include <string.h>
+#include "Benchmark.h"
+#include "DW1000.h"
+
+// the switch of the request: long range blinks at 110 kb/s, then ranging at 6.8 Mb/s
+static constexpr DW1000TuneImage blinkImage = DW1000::computeTuneImage(PROFILE_LONGDATA_RANGE_LOWPOWER);
+static constexpr DW1000TuneImage rangingImage = DW1000::computeTuneImage(PROFILE_SHORTDATA_FAST_ACCURACY);
+
+// the mode dependent registers, in full
+static const uint8_t modeRegisters[] = {SYS_CFG, TX_FCTRL, CHAN_CTRL, AGC_TUNE, DRX_TUNE, LDE_IF, TX_POWER, RF_CONF, TX_CAL, FS_CTRL};
+#define MODE_REGISTER_SIZE 0x30
+
+static void readModeRegisters(HostPort &port, uint8_t registers[][MODE_REGISTER_SIZE])
+{
+	for (uint8_t i = 0; i < sizeof(modeRegisters); i++)
+	{
+		port.getRegister(modeRegisters[i], 0, registers[i], MODE_REGISTER_SIZE);
+	}
+}
+
+bool runModeSwitchBenchmark()
+{
+	HostPort port;
+	DW1000 dw1000(port);
+	dw1000.begin();
+	dw1000.newConfiguration();
+	dw1000.setDefaults();
+	dw1000.enableMode(DW1000::MODE_SHORTDATA_FAST_ACCURACY);
+	// picks the preamble code of the pulse frequency
+	dw1000.setChannel(DW1000::CHANNEL_5);
+	dw1000.commitConfiguration();
+	uint8_t committed[sizeof(modeRegisters)][MODE_REGISTER_SIZE];
+	readModeRegisters(port, committed);
+
+	const uint32_t switches = 10000;
+	printCostHeader("Mode switch, 110 kb/s blink <-> 6.8 Mb/s ranging (per switch)");
+	BenchmarkCost baseline = measureCost(port, switches, [&](uint32_t i)
+										 {
+		dw1000.newConfiguration();
+		dw1000.enableMode(i % 2 == 0 ? DW1000::MODE_LONGDATA_RANGE_LOWPOWER : DW1000::MODE_SHORTDATA_FAST_ACCURACY);
+		dw1000.setChannel(DW1000::CHANNEL_5);
+		dw1000.commitConfiguration(); });
+	printCost("enableMode(), setChannel(), commitConfiguration()", baseline);
+	BenchmarkCost image = measureCost(port, switches, [&](uint32_t i)
+									  { dw1000.switchMode(i % 2 == 0 ? blinkImage : rangingImage); });
+	printCost("switchMode()", image);
+
+	// both ways end up with the same registers
+	uint8_t switched[sizeof(modeRegisters)][MODE_REGISTER_SIZE];
+	readModeRegisters(port, switched);
+	if (memcmp(committed, switched, sizeof(committed)) != 0)
+	{
+		printf("switchMode() registers differ from commitConfiguration()\n");
+		return false;
+	}
+	return image.bytes < baseline.bytes;
+}
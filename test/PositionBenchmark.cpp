@@ -0,0 +1,74 @@
+#include <random>
+#include "Benchmark.h"
+#include "DW1000Position.h"
+
+// up to 12 anchors on a circle of 10 m, alternately at 2.5 and 0.5 m height
+static void setAnchors(DW1000Position &position, uint8_t n, uint16_t addresses[], float coordinates[][3])
+{
+	position.clearAnchors();
+	for (uint8_t i = 0; i < n; i++)
+	{
+		float angle = 2 * (float)M_PI * i / n;
+		coordinates[i][0] = 10 * cosf(angle);
+		coordinates[i][1] = 10 * sinf(angle);
+		coordinates[i][2] = i % 2 == 0 ? 2.5f : 0.5f;
+		addresses[i] = 0x0100 + i;
+		position.setAnchor(addresses[i], coordinates[i][0], coordinates[i][1], coordinates[i][2]);
+	}
+}
+
+bool runPositionBenchmark()
+{
+	const uint32_t solves = 2000;
+	std::mt19937 generator(49);
+	std::normal_distribution<float> noise(0, 0.05f);
+	bool ok = true;
+	printf("\nPosition solve, 3D, 5 cm range noise (per solve, host CPU)\n%-10s %10s %10s %10s %10s\n", "anchors", "cold us", "iterations", "warm us", "iterations");
+	for (uint8_t n = 4; n <= MAX_POSITION_ANCHORS; n++)
+	{
+		DW1000Position position;
+		uint16_t addresses[MAX_POSITION_ANCHORS];
+		float coordinates[MAX_POSITION_ANCHORS][3];
+		float weights[MAX_POSITION_ANCHORS];
+		setAnchors(position, n, addresses, coordinates);
+
+		// a tag walking in the middle of the anchors, ranges precomputed out of the timed loops
+		static float ranges[2000][MAX_POSITION_ANCHORS];
+		for (uint32_t s = 0; s < solves; s++)
+		{
+			float tag[3] = {-3 + 6.0f * s / solves, 2 * sinf(s / 100.0f), 1};
+			for (uint8_t i = 0; i < n; i++)
+			{
+				float dx = tag[0] - coordinates[i][0], dy = tag[1] - coordinates[i][1], dz = tag[2] - coordinates[i][2];
+				ranges[s][i] = sqrtf(dx * dx + dy * dy + dz * dz) + noise(generator);
+				weights[i] = 1;
+			}
+		}
+
+		PositionFix fix;
+		uint32_t coldIterations = 0, warmIterations = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t s = 0; s < solves; s++)
+		{
+			// forgets the last fix
+			position.setDimensions(3);
+			ok &= position.solve(addresses, ranges[s], weights, n, fix);
+			coldIterations += fix.iterations;
+		}
+		auto middle = std::chrono::steady_clock::now();
+		for (uint32_t s = 0; s < solves; s++)
+		{
+			ok &= position.solve(addresses, ranges[s], weights, n, fix);
+			warmIterations += fix.iterations;
+		}
+		auto end = std::chrono::steady_clock::now();
+		float coldUs = std::chrono::duration<float, std::micro>(middle - start).count() / solves;
+		float warmUs = std::chrono::duration<float, std::micro>(end - middle).count() / solves;
+		printf("%-10u %10.2f %10.1f %10.2f %10.1f\n", n, coldUs, (float)coldIterations / solves, warmUs, (float)warmIterations / solves);
+	}
+	if (!ok)
+	{
+		printf("solve() failed on a consistent geometry\n");
+	}
+	return ok;
+}
@@ -0,0 +1,88 @@
+#include "Test.h"
+#include "DW1000Position.h"
+
+// anchors at two heights around an 8 x 6 m room
+#define TEST_ANCHORS 6
+static const uint16_t addresses[TEST_ANCHORS] = {0x0101, 0x0102, 0x0103, 0x0104, 0x0105, 0x0106};
+static const float anchors[TEST_ANCHORS][3] = {{0, 0, 2.5f}, {8, 0, 2.5f}, {8, 6, 2.5f}, {0, 6, 2.5f}, {4, 0, 0.5f}, {4, 6, 0.5f}};
+static const float weights[TEST_ANCHORS] = {1, 1, 1, 1, 1, 1};
+
+static void setAnchors(DW1000Position &position)
+{
+	for (uint8_t i = 0; i < TEST_ANCHORS; i++)
+	{
+		position.setAnchor(addresses[i], anchors[i][0], anchors[i][1], anchors[i][2]);
+	}
+}
+
+static void measure(const float tag[3], float ranges[TEST_ANCHORS])
+{
+	for (uint8_t i = 0; i < TEST_ANCHORS; i++)
+	{
+		float dx = tag[0] - anchors[i][0], dy = tag[1] - anchors[i][1], dz = tag[2] - anchors[i][2];
+		ranges[i] = sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+}
+
+static void testExactRanges()
+{
+	DW1000Position position;
+	setAnchors(position);
+	const float tag[3] = {3, 2, 1.2f};
+	float ranges[TEST_ANCHORS];
+	measure(tag, ranges);
+	PositionFix fix;
+	CHECK(position.solve(addresses, ranges, weights, TEST_ANCHORS, fix));
+	CHECK(fix.valid);
+	CHECK_NEAR(fix.x, tag[0], 1e-3);
+	CHECK_NEAR(fix.y, tag[1], 1e-3);
+	CHECK_NEAR(fix.z, tag[2], 1e-3);
+	CHECK_NEAR(fix.residual, 0, 1e-3);
+	CHECK(fix.anchors == TEST_ANCHORS);
+	CHECK(fix.gdop > 0 && fix.gdop < 5);
+
+	// 2D at a known height, x and y only
+	position.setDimensions(2, tag[2]);
+	CHECK(position.solve(addresses, ranges, weights, TEST_ANCHORS, fix));
+	CHECK_NEAR(fix.x, tag[0], 1e-3);
+	CHECK_NEAR(fix.y, tag[1], 1e-3);
+	CHECK(fix.z == tag[2]);
+
+	// 3D needs four anchors, unknown ones do not count
+	position.setDimensions(3);
+	const uint16_t unknown[4] = {0x0101, 0x0102, 0x0103, 0x0999};
+	CHECK(!position.solve(unknown, ranges, weights, 4, fix));
+	CHECK(!fix.valid);
+	CHECK(fix.anchors == 3);
+}
+
+static void testRejectedFix()
+{
+	DW1000Position position;
+	setAnchors(position);
+	const float tag[3] = {5, 4, 1};
+	float ranges[TEST_ANCHORS];
+	measure(tag, ranges);
+	PositionFix fix;
+	CHECK(position.solve(addresses, ranges, weights, TEST_ANCHORS, fix));
+
+	// ranges that do not fit together are no fix
+	float wrong[TEST_ANCHORS];
+	measure(tag, wrong);
+	wrong[0] += 6;
+	wrong[2] -= 3;
+	CHECK(!position.solve(addresses, wrong, weights, TEST_ANCHORS, fix));
+	CHECK(!fix.valid);
+
+	// nor the starting point of the next solve: from the last valid fix one step is enough
+	CHECK(position.solve(addresses, ranges, weights, TEST_ANCHORS, fix));
+	CHECK(fix.iterations == 1);
+	CHECK_NEAR(fix.x, tag[0], 1e-3);
+	CHECK_NEAR(fix.y, tag[1], 1e-3);
+}
+
+void runPositionTests()
+{
+	testExactRanges();
+	testRejectedFix();
+}
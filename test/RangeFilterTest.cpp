@@ -0,0 +1,159 @@
+#include <random>
+#include "Test.h"
+#include "DW1000RangeFilter.h"
+
+// ranges every 100 ms, 5 cm noise
+#define TEST_PERIOD_MS 100
+#define TEST_NOISE 0.05f
+
+static void testOutlierGate()
+{
+	DW1000RangeFilter filter;
+	filter.configure({TEST_NOISE, 3, 2, 1, 0.5f});
+	float range = 0, rate = 0;
+	uint32_t time = 0;
+	for (uint8_t i = 0; i < 20; i++, time += TEST_PERIOD_MS)
+	{
+		range = 5;
+		CHECK(filter.update(0, time, range, rate));
+	}
+
+	// a spike is dropped, the outputs are left untouched
+	float spike = 10, spikeRate = -1;
+	CHECK(!filter.update(0, time, spike, spikeRate));
+	CHECK(spike == 10);
+	CHECK(spikeRate == -1);
+	time += TEST_PERIOD_MS;
+	range = 5.02f;
+	CHECK(filter.update(0, time, range, rate));
+	CHECK_NEAR(range, 5, 0.02);
+	time += TEST_PERIOD_MS;
+
+	// a lasting jump is dropped maxRejects times, then the filter starts over from it
+	for (uint8_t i = 0; i < 2; i++, time += TEST_PERIOD_MS)
+	{
+		range = 8;
+		CHECK(!filter.update(0, time, range, rate));
+	}
+	range = 8;
+	CHECK(filter.update(0, time, range, rate));
+	CHECK(range == 8);
+	CHECK(rate == 0);
+	time += TEST_PERIOD_MS;
+	range = 8;
+	CHECK(filter.update(0, time, range, rate));
+	CHECK_NEAR(range, 8, 1e-4);
+}
+
+static void testMedian()
+{
+	DW1000RangeFilter filter;
+	filter.configure({0, 0, 0, 5, 0});
+	const float ranges[] = {1, 2, 100, 3, 4, 5, 6, 7, 8, 9};
+	// median of the last (up to) five, the upper one of an even count
+	const float medians[] = {1, 2, 2, 3, 3, 4, 5, 5, 6, 7};
+	for (uint8_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++)
+	{
+		float range = ranges[i], rate = 0;
+		CHECK(filter.update(0, i * TEST_PERIOD_MS, range, rate));
+		CHECK(range == medians[i]);
+	}
+
+	// lengths above the window size are clamped, a length of 1 passes the ranges through
+	filter.configure({0, 0, 0, 9, 0});
+	CHECK(filter.getConfig().medianLength == RANGE_FILTER_MEDIAN_MAX);
+	filter.configure({0, 0, 0, 1, 0});
+	CHECK(!filter.isEnabled());
+}
+
+static void testKalmanConvergence()
+{
+	DW1000RangeFilter filter;
+	filter.configure({TEST_NOISE, 0, 0, 1, 0.1f});
+	std::mt19937 generator(48);
+	std::normal_distribution<float> noise(0, TEST_NOISE);
+
+	// a tag walking away at 1.5 m/s from 10 m
+	float squares = 0, rawSquares = 0;
+	float range = 0, rate = 0, truth = 0;
+	uint32_t time = 0;
+	for (uint16_t i = 0; i < 300; i++, time += TEST_PERIOD_MS)
+	{
+		truth = 10 + 1.5f * time / 1000.0f;
+		range = truth + noise(generator);
+		float raw = range;
+		CHECK(filter.update(0, time, range, rate));
+		if (i >= 200)
+		{
+			squares += (range - truth) * (range - truth);
+			rawSquares += (raw - truth) * (raw - truth);
+		}
+	}
+	CHECK_NEAR(range, truth, 0.05);
+	CHECK_NEAR(rate, 1.5, 0.1);
+	// converged, the error is well below the range noise
+	CHECK(squares < 0.5f * rawSquares);
+
+	// extrapolation to a common epoch
+	float ranges[RANGE_FILTER_CHANNELS];
+	filter.predict(time - TEST_PERIOD_MS + 500, ranges);
+	CHECK_NEAR(ranges[0], truth + 1.5f * 0.5f, 0.1);
+}
+
+static void feed(DW1000RangeFilter &filter, uint8_t channel, uint32_t time, float range)
+{
+	float rate;
+	filter.update(channel, time, range, rate);
+}
+
+static void testMoveAndReset()
+{
+	RangeFilterConfig config = {TEST_NOISE, 3, 2, 3, 0.5f};
+	DW1000RangeFilter filter, reference;
+	filter.configure(config);
+	reference.configure(config);
+	// channel 0 stands still at 3 m, channel 1 closes in from 7 m
+	uint32_t time = 0;
+	for (uint8_t i = 0; i < 31; i++, time += TEST_PERIOD_MS)
+	{
+		float range = 7 - 0.05f * i + (i % 3) * 0.01f;
+		feed(filter, 0, time, 3);
+		feed(reference, 0, time, 3);
+		feed(filter, 1, time, range);
+		feed(reference, 1, time, range);
+	}
+
+	// channel 1 moves to 4: it goes on exactly as it would have, channel 1 starts over
+	filter.move(1, 4);
+	float before[RANGE_FILTER_CHANNELS], after[RANGE_FILTER_CHANNELS];
+	reference.predict(time, before);
+	filter.predict(time, after);
+	CHECK(after[4] == before[1]);
+	CHECK(after[0] == before[0]);
+	CHECK(after[1] == 0);
+	for (uint8_t i = 0; i < 5; i++, time += TEST_PERIOD_MS)
+	{
+		float range = 5.5f - 0.05f * i, rate, moved = range, movedRate;
+		CHECK(reference.update(1, time, range, rate) == filter.update(4, time, moved, movedRate));
+		CHECK(moved == range);
+		CHECK(movedRate == rate);
+	}
+
+	// a reset channel takes the next range as it is
+	filter.reset(4);
+	float range = 2, rate = 1;
+	CHECK(filter.update(4, time, range, rate));
+	CHECK(range == 2);
+	CHECK(rate == 0);
+	filter.predict(time, after);
+	reference.predict(time, before);
+	CHECK(after[0] == before[0]);
+}
+
+void runRangeFilterTests()
+{
+	testOutlierGate();
+	testMedian();
+	testKalmanConvergence();
+	testMoveAndReset();
+}
@@ -0,0 +1,121 @@
+#include "Test.h"
+#include "HostPort.h"
+#include "DW1000Ranging.h"
+
+static const uint8_t testMac[6] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+
+// the last round with a frame sent reported by the energy handler, and its length on the port clock
+static HostPort *energyPort;
+static RadioEnergy sendingRound;
+static uint32_t sendingRoundLength;
+static uint32_t lastRoundEnd;
+static uint16_t sendingRounds;
+
+static void onRoundEnergy(const RadioEnergy *energy)
+{
+	uint32_t now = energyPort->micros();
+	if (energy->txUs > 0)
+	{
+		sendingRound = *energy;
+		sendingRoundLength = now - lastRoundEnd;
+		sendingRounds++;
+	}
+	lastRoundEnd = now;
+}
+
+// the loop called every 100 us for ms milliseconds
+static void run(DW1000Ranging &ranging, HostPort &port, uint32_t ms)
+{
+	for (uint32_t i = 0; i < ms * 10; i++)
+	{
+		ranging.loop();
+		port.delay_us(100);
+	}
+}
+
+static void testRoundEnergy()
+{
+	HostPort port;
+	DW1000Ranging ranging(port);
+	energyPort = &port;
+	ranging.init(BoardType::TAG, testMac, 0x0102, false, PROFILE_SHORTDATA_FAST_ACCURACY);
+	ranging.setPowerMode(PowerMode::DUTY_CYCLED);
+	ranging.attachRoundEnergy(onRoundEnergy);
+	// no anchor known yet, a BLINK every fifth round
+	sendingRounds = 0;
+	run(ranging, port, 6000);
+	CHECK(sendingRounds == 2);
+
+	// every microsecond of the round in exactly one state, the BLINK on air only once, then
+	// listening for the RANGING_INITs and asleep
+	CHECK(sendingRound.sleepUs + sendingRound.idleUs + sendingRound.rxUs + sendingRound.txUs == sendingRoundLength);
+	CHECK(sendingRound.txUs > 0 && sendingRound.txUs < 1000);
+	// the slots of the RANGING_INITs: 8 * 5 * DEFAULT_REPLY_DELAY_TIME / 2 and the timeout margin
+	CHECK_NEAR(sendingRound.rxUs, 63000, 1000);
+	CHECK(sendingRound.sleepUs > 5 * sendingRound.rxUs);
+}
+
+static void testTdoaRoundEnergy()
+{
+	HostPort port;
+	DW1000Ranging ranging(port);
+	energyPort = &port;
+	ranging.init(BoardType::TAG, testMac, 0x0102, false, PROFILE_SHORTDATA_FAST_ACCURACY);
+	ranging.setRangingMode(RangingMode::TDOA_BLINK);
+	ranging.setPowerMode(PowerMode::DUTY_CYCLED);
+	ranging.attachRoundEnergy(onRoundEnergy);
+	// a BLINK every round, past the inactivity watchdog (DEFAULT_RESET_PERIOD)
+	sendingRounds = 0;
+	run(ranging, port, 3000);
+	CHECK(sendingRounds >= 3);
+
+	// the BLINK on air once, no listening at all, then asleep
+	CHECK(sendingRound.sleepUs + sendingRound.idleUs + sendingRound.rxUs + sendingRound.txUs == sendingRoundLength);
+	CHECK(sendingRound.txUs > 0 && sendingRound.txUs < 1000);
+	CHECK(sendingRound.rxUs == 0);
+	CHECK(sendingRound.sleepUs > sendingRoundLength / 2);
+}
+
+// a reset leaves no DW1000 on the bus: DEV_ID reads back zero
+class AbsentChipPort : public HostPort
+{
+public:
+	void dw1000_set_reset(bool asserted)
+	{
+		HostPort::dw1000_set_reset(asserted);
+		const uint8_t devId[LEN_DEV_ID] = {};
+		setRegister(DEV_ID, 0, devId, LEN_DEV_ID);
+	}
+};
+
+static int readyResult;
+
+static void onReady(bool ok)
+{
+	readyResult = ok ? 1 : 0;
+}
+
+static void testFailedBringUp()
+{
+	AbsentChipPort port;
+	DW1000Ranging ranging(port);
+	readyResult = -1;
+	ranging.initAsync(BoardType::TAG, testMac, 0x0102, false, PROFILE_SHORTDATA_FAST_ACCURACY, onReady);
+	// rejected while the bring-up runs, nothing written to the chip
+	ranging.setPowerMode(PowerMode::DUTY_CYCLED);
+	CHECK(ranging.getPowerMode() == PowerMode::ALWAYS_ON);
+	run(ranging, port, 100);
+	CHECK(readyResult == 0);
+
+	// the protocol does not run on the missing chip
+	port.resetCounters();
+	run(ranging, port, 1000);
+	CHECK(port.getTransactions() == 0);
+}
+
+void runRangingTests()
+{
+	testRoundEnergy();
+	testTdoaRoundEnergy();
+	testFailedBringUp();
+}
@@ -0,0 +1,59 @@
+#include "Benchmark.h"
+#include "DW1000.h"
+
+// the configuration DW1000Ranging::reinitChip() restores, see configureNetwork()
+static void configure(DW1000 &dw1000)
+{
+	uint8_t eui[LEN_EUI] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+	dw1000.setEUI(eui);
+	dw1000.newConfiguration();
+	dw1000.setDefaults();
+	dw1000.setDeviceAddress(0x0101);
+	dw1000.setNetworkId(0xDECA);
+	dw1000.enableProfile(PROFILE_SHORTDATA_FAST_ACCURACY);
+	dw1000.commitConfiguration();
+}
+
+bool runRecoveryBenchmark()
+{
+	HostPort port;
+	DW1000 dw1000(port);
+	dw1000.begin();
+	configure(dw1000);
+
+	const uint32_t recoveries = 1000;
+	bool ok = true;
+	printCostHeader("Chip recovery, DW1000Ranging::reinitChip() (per recovery)");
+	BenchmarkCost intact = measureCost(port, recoveries, [&](uint32_t)
+									   { ok &= dw1000.warmRestart() && dw1000.getRestoredRegisters() == 0; });
+	printCost("warmRestart(), configuration intact", intact);
+
+	const uint8_t lostMask[LEN_SYS_MASK] = {};
+	BenchmarkCost mask = measureCost(port, recoveries, [&](uint32_t)
+									 {
+		port.setRegister(SYS_MASK, 0, lostMask, LEN_SYS_MASK);
+		ok &= dw1000.warmRestart() && dw1000.getRestoredRegisters() == 1; });
+	printCost("warmRestart(), interrupt mask lost", mask);
+
+	const uint8_t lostTune[LEN_AGC_TUNE1] = {};
+	BenchmarkCost tune = measureCost(port, recoveries, [&](uint32_t)
+									 {
+		port.setRegister(AGC_TUNE, AGC_TUNE1_SUB, lostTune, LEN_AGC_TUNE1);
+		ok &= dw1000.warmRestart() && dw1000.getRestoredRegisters() == 1; });
+	printCost("warmRestart(), tuning lost", tune);
+
+	BenchmarkCost full = measureCost(port, recoveries, [&](uint32_t)
+									 {
+		port.powerOnReset();
+		ok &= !dw1000.warmRestart();
+		dw1000.select();
+		configure(dw1000); });
+	// the host time includes clearing the register memory of the stand-in
+	printCost("chip reset: select() and configuration", full);
+
+	if (!ok)
+	{
+		printf("warmRestart() did not restore as expected\n");
+	}
+	return ok && full.elapsedUs > 10 * tune.elapsedUs;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include <math.h>
+
+// failed checks of the whole run
+extern int testFailures;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do \
+	{ \
+		double _actual = (actual), _expected = (expected); \
+		if (!(fabs(_actual - _expected) <= (tolerance))) \
+		{ \
+			printf("%s:%d: %s = %g, expected %g +- %g\n", __FILE__, __LINE__, #actual, _actual, \
+				   _expected, (double)(tolerance)); \
+			testFailures++; \
+		} \
+	} while (0)
+
+// each adds its failed checks to testFailures
+void runDW1000Tests();
+void runAntennaCalibrationTests();
+void runRangeFilterTests();
+void runPositionTests();
+void runRangingTests();
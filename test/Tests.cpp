@@ -0,0 +1,21 @@
+#include "Test.h"
+
+int testFailures = 0;
+
+// host tests of the allocation free modules, on synthetic data with a known answer, and of the
+// driver and the ranging protocol on HostPort
+int main()
+{
+	runDW1000Tests();
+	runAntennaCalibrationTests();
+	runRangeFilterTests();
+	runPositionTests();
+	runRangingTests();
+	if (testFailures > 0)
+	{
+		printf("%d checks failed\n", testFailures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}